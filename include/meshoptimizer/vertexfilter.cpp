@@ -0,0 +1,344 @@
+// This file is part of meshoptimizer library; see meshoptimizer.h for version/license details
+#include "meshoptimizer.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+// The block below auto-detects SIMD ISA that can be used on the target platform
+#ifndef MESHOPTIMIZER_NO_SIMD
+
+// The SIMD implementation requires SSE2, which is the x64 baseline and MSVC's default for x86
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE
+#endif
+
+#endif // !MESHOPTIMIZER_NO_SIMD
+
+#ifdef SIMD_SSE
+#include <emmintrin.h>
+#endif
+
+namespace meshopt
+{
+
+template <typename T>
+static void decodeFilterOct(T* data, size_t count)
+{
+	const float max = float((1 << (sizeof(T) * 8 - 1)) - 1);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		// convert x and y to floats and reconstruct z; this assumes zf encodes 1.f at the same bit count
+		float x = float(data[i * 4 + 0]);
+		float y = float(data[i * 4 + 1]);
+		float z = float(data[i * 4 + 2]) - fabsf(x) - fabsf(y);
+
+		// fixup octahedral coordinates for z<0
+		float t = (z < 0.f) ? z : 0.f;
+
+		x += (x >= 0.f) ? t : -t;
+		y += (y >= 0.f) ? t : -t;
+
+		// compute normal length & scale
+		float l = sqrtf(x * x + y * y + z * z);
+		float s = max / l;
+
+		// rounded signed float->int
+		int xf = int(x * s + (x >= 0.f ? 0.5f : -0.5f));
+		int yf = int(y * s + (y >= 0.f ? 0.5f : -0.5f));
+		int zf = int(z * s + (z >= 0.f ? 0.5f : -0.5f));
+
+		data[i * 4 + 0] = T(xf);
+		data[i * 4 + 1] = T(yf);
+		data[i * 4 + 2] = T(zf);
+	}
+}
+
+static void decodeFilterQuat(short* data, size_t count)
+{
+	const float scale = 1.f / sqrtf(2.f);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		// recover scale from the high byte of the component
+		int sf = data[i * 4 + 3] | 3;
+		float ss = scale / float(sf);
+
+		// convert x/y/z to [-1..1] (scaled...)
+		float x = float(data[i * 4 + 0]) * ss;
+		float y = float(data[i * 4 + 1]) * ss;
+		float z = float(data[i * 4 + 2]) * ss;
+
+		// reconstruct w as a square root; we clamp to 0.f to avoid NaN due to precision errors
+		float ww = 1.f - x * x - y * y - z * z;
+		float w = sqrtf(ww >= 0.f ? ww : 0.f);
+
+		// rounded signed float->int
+		int xf = int(x * 32767.f + (x >= 0.f ? 0.5f : -0.5f));
+		int yf = int(y * 32767.f + (y >= 0.f ? 0.5f : -0.5f));
+		int zf = int(z * 32767.f + (z >= 0.f ? 0.5f : -0.5f));
+		int wf = int(w * 32767.f + 0.5f);
+
+		int qc = data[i * 4 + 3] & 3;
+
+		// output order is dictated by input index
+		data[i * 4 + ((qc + 1) & 3)] = short(xf);
+		data[i * 4 + ((qc + 2) & 3)] = short(yf);
+		data[i * 4 + ((qc + 3) & 3)] = short(zf);
+		data[i * 4 + ((qc + 0) & 3)] = short(wf);
+	}
+}
+
+static void decodeFilterExp(unsigned int* data, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		unsigned int v = data[i];
+
+		// decode mantissa and exponent
+		int m = int(v << 8) >> 8;
+		int e = int(v) >> 24;
+
+		union
+		{
+			float f;
+			unsigned int ui;
+		} u;
+
+		// optimized version of ldexp(float(m), e)
+		u.ui = unsigned(e + 127) << 23;
+		u.f = u.f * float(m);
+
+		data[i] = u.ui;
+	}
+}
+
+#ifdef SIMD_SSE
+// round half away from zero like the scalar paths, rather than to even like the conversion instructions
+static __m128i roundSigned(__m128 v)
+{
+	__m128 half = _mm_or_ps(_mm_set1_ps(0.5f), _mm_and_ps(v, _mm_set1_ps(-0.f)));
+
+	return _mm_cvttps_epi32(_mm_add_ps(v, half));
+}
+
+// reconstructs z and renormalizes four octahedral vectors, scaling them back to max
+static void decodeOct4(__m128& x, __m128& y, __m128& z, float max)
+{
+	const __m128 sign = _mm_set1_ps(-0.f);
+
+	// convert x and y to floats and reconstruct z; this assumes zf encodes 1.f at the same bit count
+	z = _mm_sub_ps(_mm_sub_ps(z, _mm_andnot_ps(sign, x)), _mm_andnot_ps(sign, y));
+
+	// fixup octahedral coordinates for z<0
+	__m128 t = _mm_min_ps(z, _mm_setzero_ps());
+
+	x = _mm_add_ps(x, _mm_xor_ps(t, _mm_and_ps(x, sign)));
+	y = _mm_add_ps(y, _mm_xor_ps(t, _mm_and_ps(y, sign)));
+
+	// compute normal length & scale
+	__m128 ll = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+	__m128 s = _mm_div_ps(_mm_set1_ps(max), _mm_sqrt_ps(ll));
+
+	x = _mm_mul_ps(x, s);
+	y = _mm_mul_ps(y, s);
+	z = _mm_mul_ps(z, s);
+}
+
+static void decodeFilterOctSimd(signed char* data, size_t count)
+{
+	for (size_t i = 0; i < count; i += 4)
+	{
+		__m128i n4 = _mm_loadu_si128(reinterpret_cast<__m128i*>(&data[i * 4]));
+
+		// sign-extend each of x/y/z from its byte of the vertex's 32-bit lane
+		__m128 x = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(n4, 24), 24));
+		__m128 y = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(n4, 16), 24));
+		__m128 z = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(n4, 8), 24));
+
+		decodeOct4(x, y, z, 127.f);
+
+		__m128i xf = _mm_and_si128(roundSigned(x), _mm_set1_epi32(0xff));
+		__m128i yf = _mm_and_si128(roundSigned(y), _mm_set1_epi32(0xff));
+		__m128i zf = _mm_and_si128(roundSigned(z), _mm_set1_epi32(0xff));
+
+		// w is preserved as is
+		__m128i res = _mm_and_si128(n4, _mm_set1_epi32(0xff000000));
+		res = _mm_or_si128(res, xf);
+		res = _mm_or_si128(res, _mm_slli_epi32(yf, 8));
+		res = _mm_or_si128(res, _mm_slli_epi32(zf, 16));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&data[i * 4]), res);
+	}
+}
+
+static void decodeFilterOctSimd(short* data, size_t count)
+{
+	for (size_t i = 0; i < count; i += 4)
+	{
+		__m128 n4_0 = _mm_loadu_ps(reinterpret_cast<float*>(&data[(i + 0) * 4]));
+		__m128 n4_1 = _mm_loadu_ps(reinterpret_cast<float*>(&data[(i + 2) * 4]));
+
+		// gather xy and zw of the four vertices into a 32-bit lane each
+		__m128i xy = _mm_castps_si128(_mm_shuffle_ps(n4_0, n4_1, _MM_SHUFFLE(2, 0, 2, 0)));
+		__m128i zw = _mm_castps_si128(_mm_shuffle_ps(n4_0, n4_1, _MM_SHUFFLE(3, 1, 3, 1)));
+
+		__m128 x = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(xy, 16), 16));
+		__m128 y = _mm_cvtepi32_ps(_mm_srai_epi32(xy, 16));
+		__m128 z = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(zw, 16), 16));
+
+		decodeOct4(x, y, z, 32767.f);
+
+		__m128i xf = _mm_and_si128(roundSigned(x), _mm_set1_epi32(0xffff));
+		__m128i yf = roundSigned(y);
+		__m128i zf = _mm_and_si128(roundSigned(z), _mm_set1_epi32(0xffff));
+
+		// w is preserved as is
+		__m128i res_xy = _mm_or_si128(xf, _mm_slli_epi32(yf, 16));
+		__m128i res_zw = _mm_or_si128(zf, _mm_and_si128(zw, _mm_set1_epi32(0xffff0000)));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&data[(i + 0) * 4]), _mm_unpacklo_epi32(res_xy, res_zw));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&data[(i + 2) * 4]), _mm_unpackhi_epi32(res_xy, res_zw));
+	}
+}
+
+static void decodeFilterQuatSimd(short* data, size_t count)
+{
+	const float scale = 1.f / sqrtf(2.f);
+
+	for (size_t i = 0; i < count; i += 4)
+	{
+		__m128 q4_0 = _mm_loadu_ps(reinterpret_cast<float*>(&data[(i + 0) * 4]));
+		__m128 q4_1 = _mm_loadu_ps(reinterpret_cast<float*>(&data[(i + 2) * 4]));
+
+		// gather xy and zc of the four quaternions into a 32-bit lane each
+		__m128i xy = _mm_castps_si128(_mm_shuffle_ps(q4_0, q4_1, _MM_SHUFFLE(2, 0, 2, 0)));
+		__m128i zc = _mm_castps_si128(_mm_shuffle_ps(q4_0, q4_1, _MM_SHUFFLE(3, 1, 3, 1)));
+
+		// recover scale from the high byte of the component
+		__m128i cf = _mm_srai_epi32(zc, 16);
+		__m128 ss = _mm_div_ps(_mm_set1_ps(scale), _mm_cvtepi32_ps(_mm_or_si128(cf, _mm_set1_epi32(3))));
+
+		// convert x/y/z to [-1..1] (scaled...)
+		__m128 x = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(xy, 16), 16)), ss);
+		__m128 y = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(xy, 16)), ss);
+		__m128 z = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(zc, 16), 16)), ss);
+
+		// reconstruct w as a square root; we clamp to 0.f to avoid NaN due to precision errors
+		__m128 ww = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.f), _mm_mul_ps(x, x)), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+		__m128 w = _mm_sqrt_ps(_mm_max_ps(ww, _mm_setzero_ps()));
+
+		__m128 s = _mm_set1_ps(32767.f);
+
+		// rounded signed float->int
+		__m128i xf = roundSigned(_mm_mul_ps(x, s));
+		__m128i yf = roundSigned(_mm_mul_ps(y, s));
+		__m128i zf = roundSigned(_mm_mul_ps(z, s));
+		__m128i wf = roundSigned(_mm_mul_ps(w, s));
+
+		// pack as w, x, y, z and rotate each quaternion so w lands on the component the input index names
+		__m128i wx = _mm_or_si128(_mm_and_si128(wf, _mm_set1_epi32(0xffff)), _mm_slli_epi32(xf, 16));
+		__m128i yz = _mm_or_si128(_mm_and_si128(yf, _mm_set1_epi32(0xffff)), _mm_slli_epi32(zf, 16));
+
+		unsigned long long res[4];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&res[0]), _mm_unpacklo_epi32(wx, yz));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&res[2]), _mm_unpackhi_epi32(wx, yz));
+
+		for (int k = 0; k < 4; ++k)
+		{
+			int qc = data[(i + k) * 4 + 3] & 3;
+			unsigned long long r = res[k];
+
+			r = qc ? (r << (qc * 16)) | (r >> (64 - qc * 16)) : r;
+
+			memcpy(&data[(i + k) * 4], &r, sizeof(r));
+		}
+	}
+}
+
+static void decodeFilterExpSimd(unsigned int* data, size_t count)
+{
+	for (size_t i = 0; i < count; i += 4)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<__m128i*>(&data[i]));
+
+		// decode exponent into 2^x directly
+		__m128i ef = _mm_srai_epi32(v, 24);
+		__m128i es = _mm_slli_epi32(_mm_add_epi32(ef, _mm_set1_epi32(127)), 23);
+
+		// decode 24-bit mantissa into floating-point value
+		__m128i mf = _mm_srai_epi32(_mm_slli_epi32(v, 8), 8);
+		__m128 m = _mm_cvtepi32_ps(mf);
+
+		__m128 r = _mm_mul_ps(_mm_castsi128_ps(es), m);
+
+		_mm_storeu_ps(reinterpret_cast<float*>(&data[i]), r);
+	}
+}
+#endif
+
+} // namespace meshopt
+
+void meshopt_decodeFilterOct(void* buffer, size_t count, size_t stride)
+{
+	using namespace meshopt;
+
+	assert(stride == 4 || stride == 8);
+
+#ifdef SIMD_SSE
+	// the kernels take four elements at a time, the rest go through the scalar path
+	size_t count4 = count & ~size_t(3);
+
+	if (stride == 4)
+	{
+		decodeFilterOctSimd(static_cast<signed char*>(buffer), count4);
+		decodeFilterOct(static_cast<signed char*>(buffer) + count4 * 4, count - count4);
+	}
+	else
+	{
+		decodeFilterOctSimd(static_cast<short*>(buffer), count4);
+		decodeFilterOct(static_cast<short*>(buffer) + count4 * 4, count - count4);
+	}
+#else
+	if (stride == 4)
+		decodeFilterOct(static_cast<signed char*>(buffer), count);
+	else
+		decodeFilterOct(static_cast<short*>(buffer), count);
+#endif
+}
+
+void meshopt_decodeFilterQuat(void* buffer, size_t count, size_t stride)
+{
+	using namespace meshopt;
+
+	assert(stride == 8);
+	(void)stride;
+
+#ifdef SIMD_SSE
+	size_t count4 = count & ~size_t(3);
+
+	decodeFilterQuatSimd(static_cast<short*>(buffer), count4);
+	decodeFilterQuat(static_cast<short*>(buffer) + count4 * 4, count - count4);
+#else
+	decodeFilterQuat(static_cast<short*>(buffer), count);
+#endif
+}
+
+void meshopt_decodeFilterExp(void* buffer, size_t count, size_t stride)
+{
+	using namespace meshopt;
+
+	assert(stride > 0 && stride % 4 == 0);
+
+	size_t total = count * (stride / 4);
+
+#ifdef SIMD_SSE
+	size_t total4 = total & ~size_t(3);
+
+	decodeFilterExpSimd(static_cast<unsigned int*>(buffer), total4);
+	decodeFilterExp(static_cast<unsigned int*>(buffer) + total4, total - total4);
+#else
+	decodeFilterExp(static_cast<unsigned int*>(buffer), total);
+#endif
+}
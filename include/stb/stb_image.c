@@ -1,2 +1,49 @@
+#include <stdlib.h>
+#include <string.h>
+#include "stb_image_output.h"
+
+static void* stbi_output_malloc(size_t size);
+static void* stbi_output_realloc(void* p, size_t size);
+static void stbi_output_free(void* p);
+
+#define STBI_MALLOC(sz) stbi_output_malloc(sz)
+#define STBI_REALLOC(p,newsz) stbi_output_realloc(p,newsz)
+#define STBI_FREE(p) stbi_output_free(p)
 #define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
\ No newline at end of file
+#include "stb_image.h"
+
+static STBI_THREAD_LOCAL void* stbi_output;
+static STBI_THREAD_LOCAL size_t stbi_output_size;
+static STBI_THREAD_LOCAL int stbi_output_taken;
+
+void stbi_set_output_buffer(void* output, size_t size) {
+	stbi_output = output;
+	stbi_output_size = size;
+	stbi_output_taken = 0;
+}
+
+// the decoded image is the only allocation of exactly its size in the common cases, anything else (or a second one) still goes to the heap
+static void* stbi_output_malloc(size_t size) {
+	if(stbi_output && !stbi_output_taken && size == stbi_output_size) {
+		stbi_output_taken = 1;
+		return stbi_output;
+	}
+	return malloc(size);
+}
+
+static void* stbi_output_realloc(void* p, size_t size) {
+	if(p && p == stbi_output) {
+		void* moved = malloc(size);
+		if(moved) {
+			memcpy(moved, p, size < stbi_output_size ? size : stbi_output_size);
+		}
+		return moved;
+	}
+	return realloc(p, size);
+}
+
+static void stbi_output_free(void* p) {
+	if(p != stbi_output) {
+		free(p);
+	}
+}
\ No newline at end of file
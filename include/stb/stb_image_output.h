@@ -0,0 +1,18 @@
+#ifndef STB_IMAGE_OUTPUT_H
+#define STB_IMAGE_OUTPUT_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// lets the next stbi_load_* on this thread decode straight into output, which has to be exactly the decoded image's size
+// whether it did is up to the decoder, so compare the returned pointer against output, stbi_image_free on it is a no-op either way
+void stbi_set_output_buffer(void* output, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,44 @@
+#version 460
+
+#include "types.glsl"
+#include "extensions.glsl"
+#include "utils.glsl"
+
+#include "../shared/material.h"
+
+layout(location = 0) in vec2 inUV;
+layout(location = 1) flat in i32 inMaterialIndex;
+
+layout(set = 0, binding = 0) uniform sampler2D imageHeap[];
+
+layout(buffer_reference, scalar) restrict readonly buffer MaterialBuffer {
+    Material materials[];
+};
+
+layout(push_constant, scalar) uniform constants {
+    u64 oitBuffer;
+    u64 vertexBuffer;
+    u64 instanceBuffer;
+    MaterialBuffer materialBuffer;
+    u64 poissonDiskBuffer;
+    mat4 cameraTransform;
+    mat4 lightTransform;
+    mat4x3 modelTransform;
+    u64 clusterBuffer;
+    vec3 cameraPosition;
+    vec3 lightAngle;
+} pcs;
+
+// depth only, for the alpha tested draws of the prepass and the shadow pass
+void main() {
+    Material mat = pcs.materialBuffer.materials[inMaterialIndex];
+
+    f32 alpha = mat.baseColor.a;
+    if(bitmaskGet(mat.texBitfield, HAS_ALBEDO)) {
+        alpha *= texture(nonuniformEXT(imageHeap[mat.albedoIndex]), inUV).a;
+    }
+
+    if(alpha < mat.alphaCutoff) {
+        discard;
+    }
+}
\ No newline at end of file
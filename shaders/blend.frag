@@ -15,6 +15,8 @@ layout(location = 6) flat in i32 inMaterialIndex;
 
 #include "pbr.glsl"
 
+layout(constant_id = OIT_NODE_COUNT_CONSTANT_ID) const u32 oitNodeCount = 4;
+
 void swapNodes(inout OITNode a, inout OITNode b) {
     OITNode tmp = a;
     a = b;
@@ -27,25 +29,33 @@ void main() {
     Material mat = pcs.materialBuffer.materials[inMaterialIndex];
 
     PBRMaterial pbr = getPBRMaterial(mat, inUV);
-    vec3 outputColor = directionalLight(view, pcs.lightAngle, inPositionLight.xyz / inPositionLight.w, pcs.lightColor.rgb * pcs.lightColor.a, pbr) + ambientLight(view, pbr) + pbr.emission;
+    vec3 outputColor = directLight(inPosition, view, inPositionLight.xyz / inPositionLight.w, pbr) + ambientLight(view, pbr) + pbr.emission;
 
-    uvec2 screenCoords = uvec2(gl_FragCoord.xy - vec2(0.5f));
-    u32 baseIndex = (screenCoords.y * pcs.frameBufferWidth + screenCoords.x) * 4;
+    OITBufferHeader header = pcs.oitBuffer.header;
+    uvec2 rectCoords = uvec2(gl_FragCoord.xy - vec2(0.5f)) - uvec2(header.offsetX, header.offsetY);
+    b8 inRect = rectCoords.x < header.width && rectCoords.y < header.height;
+    u32 baseIndex = (rectCoords.y * header.width + rectCoords.x) * oitNodeCount;
     OITNode cur = OITNode(packe5bgr9(vec4(outputColor, 1.0f)), packDepthTransmittance(gl_FragCoord.z, 1.0f - pbr.albedo.a));
 
+    if(inRect) {
+        markOITTile(header, rectCoords);
+    }
+
     beginInvocationInterlockARB();
 
-    for(u32 i = 0; i < 4; i++) {
-        if(unpackDepth(pcs.oitBuffer.nodes[baseIndex + i].packedDepthTransmittance) < unpackTransmittance(cur.packedDepthTransmittance)) {
-            swapNodes(pcs.oitBuffer.nodes[baseIndex + i], cur);
+    if(inRect) {
+        for(u32 i = 0; i < oitNodeCount; i++) {
+            if(unpackDepth(pcs.oitBuffer.nodes[baseIndex + i].packedDepthTransmittance) < unpackTransmittance(cur.packedDepthTransmittance)) {
+                swapNodes(pcs.oitBuffer.nodes[baseIndex + i], cur);
+            }
+        }
+        if(cur.packedDepthTransmittance != 0) {
+            OITNode last = pcs.oitBuffer.nodes[baseIndex + oitNodeCount - 1];
+            f32 lastDepth = unpackDepth(last.packedDepthTransmittance);
+            f32 lastTransmittance = unpackTransmittance(last.packedDepthTransmittance);
+            pcs.oitBuffer.nodes[baseIndex + oitNodeCount - 1].packedColor = packe5bgr9(vec4(mix(unpacke5bgr9(last.packedColor).rgb, unpacke5bgr9(cur.packedColor).rgb, lastTransmittance), 1.0f));
+            pcs.oitBuffer.nodes[baseIndex + oitNodeCount - 1].packedDepthTransmittance = packDepthTransmittance(lastDepth, lastTransmittance * unpackTransmittance(cur.packedDepthTransmittance));
         }
-    }
-    if(cur.packedDepthTransmittance != 0) {
-        OITNode last = pcs.oitBuffer.nodes[baseIndex + 3];
-        f32 lastDepth = unpackDepth(last.packedDepthTransmittance);
-        f32 lastTransmittance = unpackTransmittance(last.packedDepthTransmittance);
-        pcs.oitBuffer.nodes[baseIndex + 3].packedColor = packe5bgr9(vec4(mix(unpacke5bgr9(last.packedColor).rgb, unpacke5bgr9(cur.packedColor).rgb, lastTransmittance), 1.0f));
-        pcs.oitBuffer.nodes[baseIndex + 3].packedDepthTransmittance = packDepthTransmittance(lastDepth, lastTransmittance * unpackTransmittance(cur.packedDepthTransmittance));
     }
 
     endInvocationInterlockARB();
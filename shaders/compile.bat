@@ -1,16 +1,5 @@
-glslc prepass.vert -o prepass.vert.spv --target-env=vulkan1.4
-glslc shadow.vert -o shadow.vert.spv --target-env=vulkan1.4
-glslc model.vert -o model.vert.spv --target-env=vulkan1.4
-glslc opaque.frag -o opaque.frag.spv --target-env=vulkan1.4
-glslc blend.frag -o blend.frag.spv --target-env=vulkan1.4
-glslc skybox.vert -o skybox.vert.spv --target-env=vulkan1.4
-glslc skybox.frag -o skybox.frag.spv --target-env=vulkan1.4
-glslc mip.comp -o mip.comp.spv --target-env=vulkan1.4
-glslc srgbmip.comp -o srgbmip.comp.spv --target-env=vulkan1.4
-glslc cube.comp -o cube.comp.spv --target-env=vulkan1.4
-glslc cubemip.comp -o cubemip.comp.spv --target-env=vulkan1.4
-glslc irradiance.comp -o irradiance.comp.spv --target-env=vulkan1.4
-glslc radiance.comp -o radiance.comp.spv --target-env=vulkan1.4
-glslc brdfintegral.comp -o brdfintegral.comp.spv --target-env=vulkan1.4
-glslc postprocess.comp -o postprocess.comp.spv --target-env=vulkan1.4
-pause
\ No newline at end of file
+for %%s in (prepass.vert visibility.vert shadow.vert model.vert opaque.frag alphatest.frag visibility.frag material.comp blend.frag wboit.frag skybox.vert skybox.frag mip.comp srgbmip.comp cube.comp cubemip.comp irradiance.comp radiance.comp brdfintegral.comp oitresolve.comp postprocess.comp bloomdown.comp bloomup.comp tonemap.comp cluster.comp) do (
+	glslc %%s -o %%s.spv --target-env=vulkan1.4 || exit /b 1
+	glslc %%s -o %%s.inc -mfmt=c --target-env=vulkan1.4 || exit /b 1
+)
+if "%~1" neq "nopause" pause
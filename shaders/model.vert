@@ -4,6 +4,7 @@
 #include "extensions.glsl"
 
 #include "../shared/vertex.h"
+#include "../shared/instance.h"
 
 layout(location = 0) out vec4 outPositionLight;
 layout(location = 1) out vec3 outPosition;
@@ -17,24 +18,29 @@ layout(buffer_reference, scalar) restrict readonly buffer VertexBuffer {
     Vertex vertices[];
 };
 
+layout(buffer_reference, scalar) restrict readonly buffer InstanceBuffer {
+    Instance instances[];
+};
+
 layout(push_constant, scalar) uniform constants {
     u64 oitBuffer;
     VertexBuffer vertexBuffer;
+    InstanceBuffer instanceBuffer;
     u64 materialBuffer;
     u64 poissonDiskBuffer;
     mat4 cameraTransform;
     mat4 lightTransform;
     mat4x3 modelTransform;
-    vec4 lightColor;
+    u64 clusterBuffer;
     vec3 cameraPosition;
     vec3 lightAngle;
-    u32 frameBufferWidth;
 } pcs;
 
 void main() {
     Vertex v = pcs.vertexBuffer.vertices[gl_VertexIndex];
 
-    mat4 modelTransform = mat4(pcs.modelTransform);
+    Instance instance = pcs.instanceBuffer.instances[gl_InstanceIndex];
+    mat4 modelTransform = mat4(pcs.modelTransform) * mat4(instance.transform);
     mat3 normalTransform = mat3(cross(modelTransform[1].xyz, modelTransform[2].xyz), cross(modelTransform[2].xyz, modelTransform[0].xyz), cross(modelTransform[0].xyz, modelTransform[1].xyz));
 
     vec3 worldPosition = vec3(modelTransform * vec4(v.position, 1.0f));
@@ -45,7 +51,7 @@ void main() {
     outTangent = normalTransform * v.tangent.xyz;
     outBitangent = cross(normalize(outNormal), normalize(outTangent)) * v.tangent.w;
     outUV = v.uv;
-    outMaterialIndex = gl_BaseInstance;
+    outMaterialIndex = i32(instance.materialIndex);
 
     gl_Position = pcs.cameraTransform * vec4(worldPosition, 1.0f);
 }
\ No newline at end of file
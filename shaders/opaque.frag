@@ -20,7 +20,11 @@ void main() {
     Material mat = pcs.materialBuffer.materials[inMaterialIndex];
 
     PBRMaterial pbr = getPBRMaterial(mat, inUV);
-    vec3 outputColor = directionalLight(view, pcs.lightAngle, inPositionLight.xyz / inPositionLight.w, pcs.lightColor.rgb * pcs.lightColor.a, pbr) + ambientLight(view, pbr) + pbr.emission;
+    // the prepass discarded the same fragments, so this only catches whatever sits behind them at exactly the same depth
+    if(bitmaskGet(getTexBitfield(mat), ALPHA_MASK) && pbr.albedo.a < mat.alphaCutoff) {
+        discard;
+    }
+    vec3 outputColor = directLight(inPosition, view, inPositionLight.xyz / inPositionLight.w, pbr) + ambientLight(view, pbr) + pbr.emission;
 
     fragColor = vec4(outputColor, 1.0f);
 }
\ No newline at end of file
@@ -4,7 +4,9 @@
 #include "utils.glsl"
 #include "../shared/material.h"
 #include "../shared/oitnode.h"
+#include "../shared/cluster.h"
 #include "../shared/vertex.h"
+#include "../shared/instance.h"
 
 #define PI 3.141593f
 #define EPSILON 0.000001f
@@ -23,20 +25,41 @@ struct PBRMaterial {
     f32 roughness;
 };
 
+layout(constant_id = TEX_BITFIELD_CONSTANT_ID) const u32 permutationTexBitfield = DYNAMIC_TEX_BITFIELD;
+
 layout(set = 0, binding = 0) uniform sampler2D imageHeap[];
 layout(set = 1, binding = 0) uniform samplerCube irradianceMap;
 layout(set = 1, binding = 1) uniform samplerCube radianceMap;
 layout(set = 1, binding = 2) uniform sampler2D brdfIntegralTex;
 layout(set = 1, binding = 3) uniform sampler2DShadow shadowMapTex;
 
+layout(buffer_reference, scalar) restrict buffer OITTileMask {
+    u32 bits[];
+};
+
 layout(buffer_reference, scalar) restrict coherent buffer OITBuffer {
+    OITBufferHeader header;
     OITNode nodes[];
 };
 
+// flags the tile containing rectCoords as having transparent fragments for oitresolve.comp
+void markOITTile(OITBufferHeader header, uvec2 rectCoords) {
+    uvec2 tile = rectCoords / OIT_TILE_SIZE;
+    u32 tileIndex = tile.y * ((header.width + OIT_TILE_SIZE - 1) / OIT_TILE_SIZE) + tile.x;
+    OITTileMask tileMask = OITTileMask(header.tileMask);
+    if((tileMask.bits[tileIndex / 32] & (1u << (tileIndex % 32))) == 0) {
+        atomicOr(tileMask.bits[tileIndex / 32], 1u << (tileIndex % 32));
+    }
+}
+
 layout(buffer_reference, scalar) restrict readonly buffer VertexBuffer {
     Vertex vertices[];
 };
 
+layout(buffer_reference, scalar) restrict readonly buffer InstanceBuffer {
+    Instance instances[];
+};
+
 layout(buffer_reference, scalar) restrict readonly buffer MaterialBuffer {
     Material materials[];
 };
@@ -45,26 +68,83 @@ layout(buffer_reference, scalar) restrict readonly buffer PoissonDiskBuffer {
     vec2 samples[];
 };
 
+layout(buffer_reference, scalar) restrict readonly buffer LightBuffer {
+    Light lights[];
+};
+
+layout(buffer_reference, scalar) restrict readonly buffer ClusterBuffer {
+    ClusterBufferHeader header;
+    Cluster clusters[];
+};
+
+#ifdef VISIBILITY_MATERIAL_PASS
+// matches VkDrawIndexedIndirectCommand
+struct DrawCommand {
+    u32 indexCount;
+    u32 instanceCount;
+    u32 firstIndex;
+    i32 vertexOffset;
+    u32 firstInstance;
+};
+
+layout(buffer_reference, scalar) restrict readonly buffer DrawCommandBuffer {
+    DrawCommand commands[];
+};
+
+layout(buffer_reference, scalar) restrict readonly buffer IndexBuffer {
+    u32 indices[];
+};
+
+// compute shaders have neither implicit derivatives nor gl_FragCoord, material.comp fills these in from the reconstructed barycentrics
+vec2 pbrFragCoord;
+f32 pbrViewDepth;
+vec2 pbrUVDx;
+vec2 pbrUVDy;
+vec3 pbrNormalDx;
+vec3 pbrNormalDy;
+
+#define PBR_TEXTURE(tex, uv) textureGrad(tex, uv, pbrUVDx, pbrUVDy)
+#define PBR_FRAG_COORD pbrFragCoord
+#define PBR_VIEW_DEPTH pbrViewDepth
+#else
+#define PBR_TEXTURE(tex, uv) texture(tex, uv)
+#define PBR_FRAG_COORD gl_FragCoord.xy
+#define PBR_VIEW_DEPTH (1.0f / gl_FragCoord.w)
+#endif
+
 layout(push_constant, scalar) uniform constants {
+#ifdef VISIBILITY_MATERIAL_PASS
+    DrawCommandBuffer drawCommands; // MaterialPassConstants::drawCommandBuffer, in the slot the OIT buffer has in every other pass
+#else
     OITBuffer oitBuffer;
+#endif
     VertexBuffer vertexBuffer;
+    InstanceBuffer instanceBuffer;
     MaterialBuffer materialBuffer;
     PoissonDiskBuffer poissonDiskBuffer;
     mat4 cameraTransform;
     mat4 lightTransform;
     mat4x3 modelTransform;
-    vec4 lightColor;
+    ClusterBuffer clusterBuffer;
     vec3 cameraPosition;
     vec3 lightAngle;
-    u32 frameBufferWidth;
+#ifdef VISIBILITY_MATERIAL_PASS
+    IndexBuffer indexBuffer;
+#endif
 } pcs;
 
 f32 isotrophicNDFFilter(vec3 normal, f32 alpha) {
 	const f32 SIGMA2 = 0.15915494f;
 	const f32 KAPPA = 0.18f;
 
+#ifdef VISIBILITY_MATERIAL_PASS
+	// only the interpolated normal has analytic derivatives, so normal map detail doesn't widen the lobe here
+	vec3 dndu = pbrNormalDx;
+	vec3 dndv = pbrNormalDy;
+#else
 	vec3 dndu = dFdx(normal);
 	vec3 dndv = dFdy(normal);
+#endif
 	f32 kernalRoughness2 = 2.0f * SIGMA2 * (dot(dndu, dndu) + dot(dndv, dndv));
 	kernalRoughness2 = min(kernalRoughness2, KAPPA);
 	return clamp(alpha + kernalRoughness2, 0.0f, 1.0f);
@@ -98,7 +178,7 @@ f32 inShadow(vec3 lightspacePos, vec3 normal) {
     f32 result = 0.0f;
     lightspacePos.xy = lightspacePos.xy * 0.5f + 0.5f;
     f32 bias = mix(0.02f, 0.0f, dot(normal, pcs.lightAngle));
-    ivec3 indexOffset = ivec3(0, ivec2(mod(gl_FragCoord.xy, ivec2(WINDOWSIZE))));
+    ivec3 indexOffset = ivec3(0, ivec2(mod(PBR_FRAG_COORD, ivec2(WINDOWSIZE))));
     
     for(i32 i = 0; i < FILTERSIZE; i++) {
 	    f32 cur = 0.0f;
@@ -107,7 +187,7 @@ f32 inShadow(vec3 lightspacePos, vec3 normal) {
 		    u32 idx = indexOffset.z + WINDOWSIZE * (indexOffset.y + WINDOWSIZE * indexOffset.x);
 		    vec3 offset = vec3(pcs.poissonDiskBuffer.samples[idx] * SAMPLERADIUS, bias);
 
-		    cur += texture(shadowMapTex, lightspacePos + offset);
+		    cur += textureLod(shadowMapTex, lightspacePos + offset, 0.0f);
 	    }
 
 	    if(cur == 0.0f || cur == 1.0f) {
@@ -121,12 +201,8 @@ f32 inShadow(vec3 lightspacePos, vec3 normal) {
     return result / (FILTERSIZE * FILTERSIZE);
 }
 
-vec3 directionalLight(vec3 view, vec3 light, vec3 lightspacePos, vec3 lightColor, PBRMaterial mat) {
-    f32 shadow = inShadow(lightspacePos, mat.normal);
-
-    if(shadow == 0.0f) {
-        return vec3(0.0f);
-    }
+// radiance arriving from the light direction, reflected towards view
+vec3 punctualLight(vec3 view, vec3 light, vec3 radiance, PBRMaterial mat) {
     vec3 halfway = normalize(view + light);
     f32 roughness2 = mat.roughness * mat.roughness;
 
@@ -137,7 +213,58 @@ vec3 directionalLight(vec3 view, vec3 light, vec3 lightspacePos, vec3 lightColor
     vec3 diffuse = (1.0f - fresnel) * (1.0f - mat.metallic) * mat.albedo.rgb / PI;
     vec3 specular = (distribution * geometry * fresnel) / (4.0f * clampedDot(mat.normal, view) * clampedDot(mat.normal, light) + EPSILON);
 
-    return (diffuse + specular) * clampedDot(mat.normal, light) * lightColor * shadow;
+    return (diffuse + specular) * clampedDot(mat.normal, light) * radiance;
+}
+
+vec3 directionalLight(vec3 view, vec3 light, vec3 lightspacePos, vec3 lightColor, PBRMaterial mat) {
+    f32 shadow = inShadow(lightspacePos, mat.normal);
+
+    if(shadow == 0.0f) {
+        return vec3(0.0f);
+    }
+    return punctualLight(view, light, lightColor * shadow, mat);
+}
+
+// the KHR_lights_punctual lights cluster.comp assigned to the cluster containing position
+vec3 clusteredLights(vec3 position, vec3 view, PBRMaterial mat) {
+    ClusterBufferHeader header = pcs.clusterBuffer.header;
+    uvec2 tile = min(uvec2(PBR_FRAG_COORD / vec2(header.screenWidth, header.screenHeight) * vec2(CLUSTER_COUNT_X, CLUSTER_COUNT_Y)), uvec2(CLUSTER_COUNT_X - 1, CLUSTER_COUNT_Y - 1));
+    f32 viewDepth = PBR_VIEW_DEPTH;
+    u32 slice = viewDepth < CLUSTER_NEAR ? 0 : min(1 + u32(log(viewDepth / CLUSTER_NEAR) / log(CLUSTER_FAR / CLUSTER_NEAR) * (CLUSTER_COUNT_Z - 2)), CLUSTER_COUNT_Z - 1);
+    u32 clusterIndex = (slice * CLUSTER_COUNT_Y + tile.y) * CLUSTER_COUNT_X + tile.x;
+
+    LightBuffer lightBuffer = LightBuffer(header.lights);
+    mat3 directionTransform = mat3(pcs.modelTransform);
+    f32 modelScale = length(directionTransform[0]);
+
+    vec3 result = vec3(0.0f);
+    u32 numLights = pcs.clusterBuffer.clusters[clusterIndex].numLights;
+    for(u32 i = 0; i < numLights; i++) {
+        Light light = lightBuffer.lights[pcs.clusterBuffer.clusters[clusterIndex].lights[i]];
+        if(light.type == LIGHT_TYPE_DIRECTIONAL) {
+            result += punctualLight(view, -normalize(directionTransform * light.direction), light.color, mat);
+            continue;
+        }
+
+        // intensities are authored against the model's own units, so distances are measured in those rather than after the base transform's scale
+        vec3 toLight = pcs.modelTransform * vec4(light.position, 1.0f) - position;
+        f32 distance = length(toLight) / modelScale;
+        vec3 direction = toLight / (distance * modelScale);
+        f32 window = clamp(1.0f - pow(distance / light.range, 4.0f), 0.0f, 1.0f);
+        f32 attenuation = window * window / max(distance * distance, EPSILON);
+        if(light.type == LIGHT_TYPE_SPOT) {
+            f32 cone = clamp(dot(normalize(directionTransform * light.direction), -direction) * light.spotScale + light.spotOffset, 0.0f, 1.0f);
+            attenuation *= cone * cone;
+        }
+        result += punctualLight(view, direction, light.color * attenuation, mat);
+    }
+    return result;
+}
+
+// everything that lights a point directly, the shadowed sun and the punctual lights around it
+vec3 directLight(vec3 position, vec3 view, vec3 lightspacePos, PBRMaterial mat) {
+    vec4 sunColor = pcs.clusterBuffer.header.sunColor;
+    return directionalLight(view, pcs.lightAngle, lightspacePos, sunColor.rgb * sunColor.a, mat) + clusteredLights(position, view, mat);
 }
 
 
@@ -152,33 +279,39 @@ vec3 ambientLight(vec3 view, PBRMaterial mat) {
 	return (diffuse + specular) * mat.occlusion;
 }
 
+u32 getTexBitfield(Material mat) {
+    return permutationTexBitfield == DYNAMIC_TEX_BITFIELD ? mat.texBitfield : permutationTexBitfield;
+}
+
 PBRMaterial getPBRMaterial(Material mat, vec2 inUV) {
     PBRMaterial result;
+    u32 texBitfield = getTexBitfield(mat);
+
     result.albedo = mat.baseColor;
-    if(bitmaskGet(mat.texBitfield, HAS_ALBEDO)) {
-        result.albedo *= texture(nonuniformEXT(imageHeap[mat.albedoIndex]), inUV);
+    if(bitmaskGet(texBitfield, HAS_ALBEDO)) {
+        result.albedo *= PBR_TEXTURE(nonuniformEXT(imageHeap[mat.albedoIndex]), inUV);
     }
 
     result.emission = mat.emissiveColor.rgb * mat.emissiveColor.a;
-    if(bitmaskGet(mat.texBitfield, HAS_EMISSIVE)) {
-        result.emission *= texture(nonuniformEXT(imageHeap[mat.emissiveIndex]), inUV).rgb;
+    if(bitmaskGet(texBitfield, HAS_EMISSIVE)) {
+        result.emission *= PBR_TEXTURE(nonuniformEXT(imageHeap[mat.emissiveIndex]), inUV).rgb;
     }
 
     result.normal = normalize(inNormal);
-    if(bitmaskGet(mat.texBitfield, HAS_NORMAL)) {
-        result.normal = normalize(mat3(normalize(inTangent), normalize(inBitangent), result.normal) * (texture(nonuniformEXT(imageHeap[mat.normalIndex]), inUV).rgb * 2.0f - 1.0f));
+    if(bitmaskGet(texBitfield, HAS_NORMAL)) {
+        result.normal = normalize(mat3(normalize(inTangent), normalize(inBitangent), result.normal) * (PBR_TEXTURE(nonuniformEXT(imageHeap[mat.normalIndex]), inUV).rgb * 2.0f - 1.0f));
     }
     
     result.occlusion = 1.0f;
-    if(bitmaskGet(mat.texBitfield, HAS_OCCLUSION)) {
-        result.occlusion *= texture(nonuniformEXT(imageHeap[mat.occlusionIndex]), inUV).r;
+    if(bitmaskGet(texBitfield, HAS_OCCLUSION)) {
+        result.occlusion *= PBR_TEXTURE(nonuniformEXT(imageHeap[mat.occlusionIndex]), inUV).r;
     }
 
     result.metallic = mat.metallic;
     result.roughness = mat.roughness;
-    if(bitmaskGet(mat.texBitfield, HAS_METALLIC_ROUGHNESS)) {
-	    result.metallic *= texture(nonuniformEXT(imageHeap[mat.metallicRoughnessIndex]), inUV).b;
-	    result.roughness *= texture(nonuniformEXT(imageHeap[mat.metallicRoughnessIndex]), inUV).g;	
+    if(bitmaskGet(texBitfield, HAS_METALLIC_ROUGHNESS)) {
+	    result.metallic *= PBR_TEXTURE(nonuniformEXT(imageHeap[mat.metallicRoughnessIndex]), inUV).b;
+	    result.roughness *= PBR_TEXTURE(nonuniformEXT(imageHeap[mat.metallicRoughnessIndex]), inUV).g;	
     }
     
     result.roughness = max(result.roughness, 0.04f);
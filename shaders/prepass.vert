@@ -3,30 +3,42 @@
 #include "extensions.glsl"
 
 #include "../shared/vertex.h"
+#include "../shared/instance.h"
 #include "../shared/material.h"
 
+// only read by alphatest.frag, the other draws have no fragment shader
+layout(location = 0) out vec2 outUV;
+layout(location = 1) flat out i32 outMaterialIndex;
+
 layout(buffer_reference, scalar) restrict readonly buffer VertexBuffer {
     Vertex vertices[];
 };
 
+layout(buffer_reference, scalar) restrict readonly buffer InstanceBuffer {
+    Instance instances[];
+};
+
 layout(push_constant, scalar) uniform constants {
     u64 oitBuffer;
     VertexBuffer vertexBuffer;
+    InstanceBuffer instanceBuffer;
     u64 materialBuffer;
     u64 poissonDiskBuffer;
     mat4 cameraTransform;
     mat4 lightTransform;
     mat4x3 modelTransform;
-    vec4 lightColor;
+    u64 clusterBuffer;
     vec3 cameraPosition;
     vec3 lightAngle;
-    u32 frameBufferWidth;
 } pcs;
 
 void main() {
     Vertex v = pcs.vertexBuffer.vertices[gl_VertexIndex];
 
-    mat4 modelTransform = mat4(pcs.modelTransform);
+    Instance instance = pcs.instanceBuffer.instances[gl_InstanceIndex];
+    mat4 modelTransform = mat4(pcs.modelTransform) * mat4(instance.transform);
+    outUV = v.uv;
+    outMaterialIndex = i32(instance.materialIndex);
 
     gl_Position = pcs.cameraTransform * (modelTransform * vec4(v.position, 1.0f));
 }
\ No newline at end of file
@@ -93,4 +93,20 @@ vec4 agx(vec3 color) {
     return vec4(color, 1.0f);
 }
 
+// dual filter upsample, a tent over the source texels around uv from four edge and four diagonal bilinear taps
+vec3 dualFilterUpsample(sampler2D tex, vec2 uv) {
+    vec2 offset = 1.0f / vec2(textureSize(tex, 0));
+
+    vec3 color = textureLod(tex, uv + vec2(-offset.x, 0.0f), 0.0f).rgb;
+    color += textureLod(tex, uv + vec2(offset.x, 0.0f), 0.0f).rgb;
+    color += textureLod(tex, uv + vec2(0.0f, -offset.y), 0.0f).rgb;
+    color += textureLod(tex, uv + vec2(0.0f, offset.y), 0.0f).rgb;
+    color += textureLod(tex, uv + vec2(-offset.x, -offset.y) * 0.5f, 0.0f).rgb * 2.0f;
+    color += textureLod(tex, uv + vec2(offset.x, -offset.y) * 0.5f, 0.0f).rgb * 2.0f;
+    color += textureLod(tex, uv + vec2(-offset.x, offset.y) * 0.5f, 0.0f).rgb * 2.0f;
+    color += textureLod(tex, uv + vec2(offset.x, offset.y) * 0.5f, 0.0f).rgb * 2.0f;
+
+    return color / 12.0f;
+}
+
 #endif
\ No newline at end of file
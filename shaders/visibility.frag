@@ -0,0 +1,16 @@
+#version 460
+
+#include "types.glsl"
+#include "extensions.glsl"
+
+#include "../shared/visibility.h"
+
+layout(location = 0) flat in u32 inDrawIndex;
+
+layout(location = 0) out u32 visibility;
+
+layout(constant_id = VISIBILITY_DRAW_BITS_CONSTANT_ID) const u32 drawBits = 16;
+
+void main() {
+    visibility = (inDrawIndex << (32 - drawBits)) | u32(gl_PrimitiveID);
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#version 460
+
+#include "types.glsl"
+#include "extensions.glsl"
+
+#include "../shared/vertex.h"
+#include "../shared/instance.h"
+
+layout(location = 0) flat out u32 outDrawIndex;
+
+layout(buffer_reference, scalar) restrict readonly buffer VertexBuffer {
+    Vertex vertices[];
+};
+
+layout(buffer_reference, scalar) restrict readonly buffer InstanceBuffer {
+    Instance instances[];
+};
+
+layout(push_constant, scalar) uniform constants {
+    u64 oitBuffer;
+    VertexBuffer vertexBuffer;
+    InstanceBuffer instanceBuffer;
+    u64 materialBuffer;
+    u64 poissonDiskBuffer;
+    mat4 cameraTransform;
+    mat4 lightTransform;
+    mat4x3 modelTransform;
+    u64 clusterBuffer;
+    vec3 cameraPosition;
+    vec3 lightAngle;
+} pcs;
+
+void main() {
+    Vertex v = pcs.vertexBuffer.vertices[gl_VertexIndex];
+
+    Instance instance = pcs.instanceBuffer.instances[gl_InstanceIndex];
+    mat4 modelTransform = mat4(pcs.modelTransform) * mat4(instance.transform);
+
+    // all opaque draws go out as one multi draw, so this indexes the opaque draw commands
+    outDrawIndex = gl_DrawID;
+
+    gl_Position = pcs.cameraTransform * (modelTransform * vec4(v.position, 1.0f));
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#version 460
+
+#include "extensions.glsl"
+#include "utils.glsl"
+
+layout(location = 0) in vec4 inPositionLight;
+layout(location = 1) in vec3 inPosition;
+layout(location = 2) in vec3 inNormal;
+layout(location = 3) in vec3 inTangent;
+layout(location = 4) in vec3 inBitangent;
+layout(location = 5) in vec2 inUV;
+layout(location = 6) flat in i32 inMaterialIndex;
+
+#include "pbr.glsl"
+
+#define NEAR_PLANE 0.1f // this is hardcoded in Renderer::run
+
+layout(location = 0) out vec4 outAccum;
+layout(location = 1) out vec4 outRevealage;
+
+// weighted blended OIT (McGuire and Bavoil 2013), used when the device has no fragment shader interlock
+layout(early_fragment_tests) in;
+void main() {
+    vec3 view = normalize(pcs.cameraPosition - inPosition);
+    Material mat = pcs.materialBuffer.materials[inMaterialIndex];
+
+    PBRMaterial pbr = getPBRMaterial(mat, inUV);
+    vec3 outputColor = directLight(inPosition, view, inPositionLight.xyz / inPositionLight.w, pbr) + ambientLight(view, pbr) + pbr.emission;
+
+    OITBufferHeader header = pcs.oitBuffer.header;
+    uvec2 rectCoords = uvec2(gl_FragCoord.xy - vec2(0.5f)) - uvec2(header.offsetX, header.offsetY);
+    if(rectCoords.x < header.width && rectCoords.y < header.height) {
+        markOITTile(header, rectCoords);
+    }
+
+    // equation 7 from the paper, depth is reversed and infinite so view depth is recovered from the near plane
+    f32 viewDepth = NEAR_PLANE / gl_FragCoord.z;
+    f32 alpha = pbr.albedo.a;
+    f32 weight = alpha * clamp(10.0f / (1e-5f + pow(viewDepth / 5.0f, 2.0f) + pow(viewDepth / 200.0f, 6.0f)), 1e-2f, 3e3f);
+
+    outAccum = vec4(outputColor * alpha, alpha) * weight;
+    outRevealage = vec4(alpha);
+}
\ No newline at end of file
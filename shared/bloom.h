@@ -0,0 +1,25 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#ifdef __cplusplus
+	#include <tbrs/types.hpp>
+#else
+	#include "../shaders/types.glsl"
+#endif
+
+// levels of the bloom pyramid, the first is half the swapchain size
+#define BLOOM_MIP_COUNT 6
+
+// bins 1 and up split log2 luminance in [HISTOGRAM_MIN_LOG_LUMINANCE, HISTOGRAM_MIN_LOG_LUMINANCE + HISTOGRAM_LOG_LUMINANCE_RANGE] evenly, bin 0 takes everything darker
+#define HISTOGRAM_BIN_COUNT 256
+#define HISTOGRAM_MIN_LOG_LUMINANCE -12.0f
+#define HISTOGRAM_LOG_LUMINANCE_RANGE 20.0f
+
+// built by the bloom downsample, whose last workgroup adapts logLuminance to it and clears it for the next frame
+struct ExposureState {
+	u32 histogram[HISTOGRAM_BIN_COUNT];
+	u32 workgroupsDone;
+	f32 logLuminance; // temporally adapted average log2 luminance
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,58 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#ifdef __cplusplus
+	#include <glm/glm.hpp>
+	#include <tbrs/types.hpp>
+	#define GLM glm::
+#else
+	#define GLM
+	#include "../shaders/types.glsl"
+#endif
+
+// the view frustum is split into CLUSTER_COUNT_X * CLUSTER_COUNT_Y screen tiles and CLUSTER_COUNT_Z exponential depth slices
+#define CLUSTER_COUNT_X 16
+#define CLUSTER_COUNT_Y 9
+#define CLUSTER_COUNT_Z 24
+#define CLUSTER_COUNT (CLUSTER_COUNT_X * CLUSTER_COUNT_Y * CLUSTER_COUNT_Z)
+
+// slice 0 ends at CLUSTER_NEAR and the last one starts at CLUSTER_FAR, in view space units
+#define CLUSTER_NEAR 0.1f
+#define CLUSTER_FAR 20.0f
+
+// lights past this many in one cluster are dropped
+#define CLUSTER_MAX_LIGHTS 256
+
+#define LIGHT_TYPE_POINT 0
+#define LIGHT_TYPE_SPOT 1
+#define LIGHT_TYPE_DIRECTIONAL 2
+
+// a KHR_lights_punctual light in model space, before the model transform
+struct Light {
+	GLM vec3 position;
+	f32 range; // distance past which the light is culled, either the authored range or where it falls off to nothing
+	GLM vec3 direction;
+	f32 spotScale;
+	GLM vec3 color; // premultiplied by intensity
+	f32 spotOffset;
+	u32 type;
+};
+
+// start of the cluster buffer, written by cluster.comp every frame
+struct ClusterBufferHeader {
+	GLM vec4 sunColor;
+	u64 lights;
+	u32 numLights;
+	u32 screenWidth;
+	u32 screenHeight;
+};
+
+// follows the header once per cluster
+struct Cluster {
+	u32 numLights;
+	u32 lights[CLUSTER_MAX_LIGHTS];
+};
+
+#undef GLM
+
+#endif
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#ifdef __cplusplus
+    #include <glm/glm.hpp>
+    #include <tbrs/types.hpp>
+    #define GLM glm::
+#else
+    #define GLM
+    #include "../shaders/types.glsl"
+#endif
+
+// one per draw instance, draws index these with gl_InstanceIndex (their firstInstance is where their instances start)
+// geometry that isn't instanced has its node transform baked into its vertices and a single identity instance
+struct Instance {
+    GLM mat4x3 transform;
+    u32 materialIndex;
+};
+
+#undef GLM
+
+#endif
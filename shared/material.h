@@ -15,6 +15,12 @@
 #define HAS_OCCLUSION 0x04
 #define HAS_METALLIC_ROUGHNESS 0x08
 #define HAS_EMISSIVE 0x10
+// not a texture, but alpha tested materials get their own permutations too, sorted after every other opaque one
+#define ALPHA_MASK 0x20
+
+// specialization constant selecting a material permutation, DYNAMIC_TEX_BITFIELD reads Material::texBitfield instead
+#define TEX_BITFIELD_CONSTANT_ID 0
+#define DYNAMIC_TEX_BITFIELD 0xFFFFFFFFu
 
 struct Material {
     GLM vec4 baseColor;
@@ -27,6 +33,7 @@ struct Material {
     u32 metallicRoughnessIndex;
     u32 emissiveIndex;
     u32 texBitfield;
+    f32 alphaCutoff;
 };
 
 #undef GLM
@@ -7,9 +7,25 @@
 	#include "../shaders/types.glsl"
 #endif
 
+// follows TEX_BITFIELD_CONSTANT_ID since blend.frag is specialised on both
+#define OIT_NODE_COUNT_CONSTANT_ID 1
+#define OIT_WEIGHTED_BLENDED_CONSTANT_ID 2
+
+// the rect is aligned to these so each oitresolve.comp workgroup covers exactly one tile
+#define OIT_TILE_SIZE 8
+
 struct OITNode {
 	u32 packedColor;
 	u32 packedDepthTransmittance;
 };
 
+// start of the OIT buffer, nodes are only stored for the pixels inside this rect
+struct OITBufferHeader {
+	u32 offsetX;
+	u32 offsetY;
+	u32 width;
+	u32 height;
+	u64 tileMask; // one bit per tile of the rect, set by blend.frag when the tile has transparent fragments
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,10 @@
+#ifndef VISIBILITY_H
+#define VISIBILITY_H
+
+// follows TEX_BITFIELD_CONSTANT_ID since material.comp is specialised on both
+#define VISIBILITY_DRAW_BITS_CONSTANT_ID 1
+
+// the visibility buffer stores (opaque draw index << (32 - draw bits)) | triangle index, the draw index never fills its bits so no pixel can pack to this
+#define VISIBILITY_EMPTY 0xFFFFFFFFu
+
+#endif
\ No newline at end of file
@@ -0,0 +1,220 @@
+#include "frame_graph.hpp"
+#include <tbrs/vk_util.hpp>
+
+static constexpr VkAccessFlags2 writeAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+FrameGraph::Resource FrameGraph::importImage(VkImage image, VkImageSubresourceRange range, b8 discard, u32 queueFamily) {
+	ResourceState* state = &m_states[{ reinterpret_cast<u64>(image), range.baseMipLevel }];
+	state->segment = ~0u;
+	if(discard) {
+		state->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+
+	m_resources.push_back(ResourceInfo{
+		.image = image,
+		.range = range,
+		.exclusive = queueFamily != VK_QUEUE_FAMILY_IGNORED,
+		.discard = discard,
+		.state = state
+	});
+	return static_cast<Resource>(m_resources.size() - 1);
+}
+
+FrameGraph::Resource FrameGraph::importBuffer(VkBuffer buffer) {
+	ResourceState* state = &m_states[{ reinterpret_cast<u64>(buffer), 0 }];
+	state->segment = ~0u;
+
+	m_resources.push_back(ResourceInfo{
+		.buffer = buffer,
+		.exclusive = false,
+		.discard = false,
+		.state = state
+	});
+	return static_cast<Resource>(m_resources.size() - 1);
+}
+
+void FrameGraph::markOutput(Resource resource, VkImageLayout finalLayout) {
+	m_resources[resource].output = true;
+	m_resources[resource].finalLayout = finalLayout;
+}
+
+void FrameGraph::addSegment(VkCommandBuffer cmdBuffer, u32 queueFamily) {
+	m_segments.push_back(Segment{ cmdBuffer, queueFamily });
+}
+
+void FrameGraph::addPass(std::vector<Access> accesses, std::function<void(VkCommandBuffer)> record) {
+	m_passes.push_back(Pass{ static_cast<u32>(m_segments.size() - 1), std::move(accesses), std::move(record) });
+}
+
+void FrameGraph::execute() {
+	// walk back from the outputs, a pass is only needed if it writes something that's read later or leaves the frame
+	std::vector<b8> needed(m_resources.size());
+	for(u64 i = 0; i < m_resources.size(); i++) {
+		needed[i] = m_resources[i].output;
+	}
+
+	std::vector<b8> live(m_passes.size());
+	for(u64 i = m_passes.size(); i-- > 0;) {
+		for(const Access& access : m_passes[i].accesses) {
+			live[i] = live[i] || ((access.access & writeAccessMask) && needed[access.resource]);
+		}
+		if(live[i]) {
+			for(const Access& access : m_passes[i].accesses) {
+				needed[access.resource] = needed[access.resource] || (access.access & ~writeAccessMask);
+			}
+		}
+	}
+
+	std::vector<std::vector<VkImageMemoryBarrier2>> imageBarriers(m_passes.size());
+	std::vector<std::vector<VkBufferMemoryBarrier2>> bufferBarriers(m_passes.size());
+
+	for(u64 i = 0; i < m_passes.size(); i++) {
+		if(!live[i]) {
+			continue;
+		}
+
+		const Pass& pass = m_passes[i];
+		const Segment& segment = m_segments[pass.segment];
+		for(const Access& access : pass.accesses) {
+			const ResourceInfo& info = m_resources[access.resource];
+			ResourceState& state = *info.state;
+
+			const b8 write = access.access & writeAccessMask;
+			const b8 firstUse = state.segment == ~0u;
+			const b8 layoutChange = info.image && access.layout != state.layout;
+			// the semaphore between the segments already orders everything from the other queue, barriers only have to chain onto its wait
+			const b8 otherQueue = state.queueFamily != VK_QUEUE_FAMILY_IGNORED && state.queueFamily != segment.queueFamily;
+			const b8 ownershipTransfer = info.exclusive && otherQueue && !firstUse;
+
+			VkPipelineStageFlags2 srcStages = 0;
+			VkAccessFlags2 srcAccess = 0;
+			b8 barrier = layoutChange;
+			if(otherQueue) {
+				srcStages = access.stages;
+			}
+			else if(write) {
+				srcStages = state.writeStages | state.readStages;
+				srcAccess = state.writeAccess;
+				barrier = barrier || srcStages != 0;
+			}
+			else {
+				srcStages = state.writeStages | (layoutChange ? state.readStages : 0);
+				srcAccess = state.writeAccess;
+				barrier = barrier || (state.writeStages != 0 && ((access.stages & ~state.readStages) || (access.access & ~state.readAccess)));
+			}
+			// a transition at the start of a frame has to wait for whatever semaphore this segment waits on, like the swapchain acquire
+			if(firstUse && layoutChange) {
+				srcStages |= access.stages;
+			}
+
+			if(ownershipTransfer) {
+				m_segments[state.segment].trailingBarriers.push_back(VkImageMemoryBarrier2{
+					.srcStageMask = state.writeStages | state.readStages,
+					.srcAccessMask = state.writeAccess,
+					.oldLayout = state.layout,
+					.newLayout = access.layout,
+					.srcQueueFamilyIndex = state.queueFamily,
+					.dstQueueFamilyIndex = segment.queueFamily,
+					.image = info.image,
+					.subresourceRange = info.range
+				});
+			}
+
+			if(barrier || ownershipTransfer) {
+				if(info.image) {
+					imageBarriers[i].push_back(VkImageMemoryBarrier2{
+						.srcStageMask = ownershipTransfer ? VK_PIPELINE_STAGE_2_NONE : srcStages,
+						.srcAccessMask = ownershipTransfer ? VK_ACCESS_2_NONE : srcAccess,
+						.dstStageMask = access.stages,
+						.dstAccessMask = access.access,
+						.oldLayout = state.layout,
+						.newLayout = access.layout,
+						.srcQueueFamilyIndex = ownershipTransfer ? state.queueFamily : VK_QUEUE_FAMILY_IGNORED,
+						.dstQueueFamilyIndex = ownershipTransfer ? segment.queueFamily : VK_QUEUE_FAMILY_IGNORED,
+						.image = info.image,
+						.subresourceRange = info.range
+					});
+				}
+				else {
+					bufferBarriers[i].push_back(VkBufferMemoryBarrier2{
+						.srcStageMask = srcStages,
+						.srcAccessMask = srcAccess,
+						.dstStageMask = access.stages,
+						.dstAccessMask = access.access,
+						.buffer = info.buffer,
+						.size = VK_WHOLE_SIZE
+					});
+				}
+			}
+
+			// a layout transition counts as a write that only this access has seen so far
+			if(write || layoutChange || otherQueue) {
+				state.writeStages = write || layoutChange ? access.stages : 0;
+				state.writeAccess = access.access & writeAccessMask;
+				state.readStages = write ? 0 : access.stages;
+				state.readAccess = write ? 0 : access.access;
+			}
+			else {
+				state.readStages |= access.stages;
+				state.readAccess |= access.access;
+			}
+			state.layout = info.image ? access.layout : state.layout;
+			state.queueFamily = segment.queueFamily;
+			state.segment = pass.segment;
+		}
+	}
+
+	// outputs leave in the layout whatever comes after the frame expects, presentation for the swapchain
+	for(const ResourceInfo& info : m_resources) {
+		ResourceState& state = *info.state;
+		if(!info.output || info.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || info.finalLayout == state.layout || state.segment == ~0u) {
+			continue;
+		}
+
+		m_segments[state.segment].trailingBarriers.push_back(VkImageMemoryBarrier2{
+			.srcStageMask = state.writeStages | state.readStages,
+			.srcAccessMask = state.writeAccess,
+			.oldLayout = state.layout,
+			.newLayout = info.finalLayout,
+			.image = info.image,
+			.subresourceRange = info.range
+		});
+		state.layout = info.finalLayout;
+		state.readStages = 0;
+		state.readAccess = 0;
+	}
+
+	for(u32 s = 0; s < m_segments.size(); s++) {
+		const Segment& segment = m_segments[s];
+		for(u64 i = 0; i < m_passes.size(); i++) {
+			if(!live[i] || m_passes[i].segment != s) {
+				continue;
+			}
+
+			if(!imageBarriers[i].empty() || !bufferBarriers[i].empty()) {
+				vkCmdPipelineBarrier2(segment.cmdBuffer, ptr(VkDependencyInfo{
+					.bufferMemoryBarrierCount = static_cast<u32>(bufferBarriers[i].size()),
+					.pBufferMemoryBarriers = bufferBarriers[i].data(),
+					.imageMemoryBarrierCount = static_cast<u32>(imageBarriers[i].size()),
+					.pImageMemoryBarriers = imageBarriers[i].data()
+				}));
+			}
+			m_passes[i].record(segment.cmdBuffer);
+		}
+
+		if(!segment.trailingBarriers.empty()) {
+			vkCmdPipelineBarrier2(segment.cmdBuffer, ptr(VkDependencyInfo{
+				.imageMemoryBarrierCount = static_cast<u32>(segment.trailingBarriers.size()),
+				.pImageMemoryBarriers = segment.trailingBarriers.data()
+			}));
+		}
+	}
+
+	m_resources.clear();
+	m_segments.clear();
+	m_passes.clear();
+}
+
+void FrameGraph::forgetResources() {
+	m_states.clear();
+}
\ No newline at end of file
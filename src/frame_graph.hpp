@@ -0,0 +1,83 @@
+#ifndef FRAME_GRAPH_HPP
+#define FRAME_GRAPH_HPP
+
+#include <tbrs/types.hpp>
+#include <volk/volk.h>
+#include <vector>
+#include <map>
+#include <functional>
+
+// records a frame's passes from the reads and writes they declare, deriving the barriers between them instead of having them written out by hand
+// resources are tracked by handle across frames, so the first barrier of a frame knows what the previous one left the resource in
+// a frame is split into segments, one per command buffer, submitted in order with semaphores between the ones on different queues
+class FrameGraph {
+	public:
+		using Resource = u32;
+
+		struct Access {
+			Resource resource;
+			VkPipelineStageFlags2 stages;
+			VkAccessFlags2 access;
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED; // ignored for buffers
+		};
+
+		// images are tracked per range, so a range has to be the same in every frame and not overlap any other imported from the image
+		// exclusive resources are owned by queueFamily and get ownership transfers when a later segment on another family needs their contents
+		// discard means this frame doesn't need what's already in the image, so it starts out undefined and never gets transferred
+		Resource importImage(VkImage image, VkImageSubresourceRange range, b8 discard, u32 queueFamily = VK_QUEUE_FAMILY_IGNORED);
+		Resource importBuffer(VkBuffer buffer);
+
+		// outputs are what the frame is for, passes that contribute to none of them (directly or through other passes) are dropped
+		// an image output is left in finalLayout at the end of the last segment using it, unless that's undefined
+		void markOutput(Resource resource, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED);
+
+		void addSegment(VkCommandBuffer cmdBuffer, u32 queueFamily);
+		void addPass(std::vector<Access> accesses, std::function<void(VkCommandBuffer)> record);
+
+		// culls, records every segment (without beginning or ending their command buffers) and clears the frame's passes
+		void execute();
+
+		// resource states refer to images that are about to be destroyed, only safe once the device is idle
+		void forgetResources();
+
+	private:
+		struct ResourceState {
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkPipelineStageFlags2 writeStages = 0;
+			VkAccessFlags2 writeAccess = 0;
+			VkPipelineStageFlags2 readStages = 0; // since the last write, these already see it
+			VkAccessFlags2 readAccess = 0;
+			u32 queueFamily = VK_QUEUE_FAMILY_IGNORED;
+			u32 segment = ~0u; // ~0u until first used this frame
+		};
+
+		struct ResourceInfo {
+			VkImage image;
+			VkBuffer buffer;
+			VkImageSubresourceRange range;
+			b8 exclusive;
+			b8 discard;
+			b8 output = false;
+			VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			ResourceState* state;
+		};
+
+		struct Pass {
+			u32 segment;
+			std::vector<Access> accesses;
+			std::function<void(VkCommandBuffer)> record;
+		};
+
+		struct Segment {
+			VkCommandBuffer cmdBuffer;
+			u32 queueFamily;
+			std::vector<VkImageMemoryBarrier2> trailingBarriers; // ownership transfers out and final layouts, recorded after the segment's last pass
+		};
+
+		std::map<std::pair<u64, u32>, ResourceState> m_states; // by handle and first mip, so mips of one image can be tracked separately
+		std::vector<ResourceInfo> m_resources;
+		std::vector<Segment> m_segments;
+		std::vector<Pass> m_passes;
+};
+
+#endif
\ No newline at end of file
@@ -1,5 +1,15 @@
 #include "renderer.hpp"
+#include <string_view>
+#include <charconv>
 
-int main() {
-	Renderer().run();
+// --staging-budget <MB> sets the host memory a model import stages its uploads through
+int main(int argc, char** argv) {
+	u64 importStagingBudget = 64;
+	for(i32 i = 1; i + 1 < argc; i++) {
+		if(std::string_view(argv[i]) == "--staging-budget") {
+			std::from_chars(argv[i + 1], argv[i + 1] + std::string_view(argv[i + 1]).size(), importStagingBudget);
+		}
+	}
+
+	Renderer(importStagingBudget << 20).run();
 }
\ No newline at end of file
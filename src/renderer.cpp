@@ -1,36 +1,120 @@
 #include "renderer.hpp"
 #include <tbrs/vk_util.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include "../shared/oitnode.h"
+#include "../shared/visibility.h"
+#include "../shared/cluster.h"
+#include "../shared/bloom.h"
+
+// radical inverse of index in base, the low discrepancy sequence the TAA jitter walks
+static f32 halton(u32 index, u32 base) {
+	f32 result = 0.0f;
+	f32 fraction = 1.0f;
+	while(index > 0) {
+		fraction /= base;
+		result += fraction * (index % base);
+		index /= base;
+	}
+	return result;
+}
 
 void Renderer::run() {
 	while(!glfwWindowShouldClose(m_window)) {
+		// sample input only once the previous frame is on screen so it's as fresh as possible when this one gets there
+		if(m_latencyLimiter && m_presentWaitSupported && m_presentId > 0) {
+			vkWaitForPresentKHR(m_device, m_swapchain, m_presentId, std::numeric_limits<u64>::max());
+		}
+
 		glfwPollEvents();
 
+#ifdef SHADER_HOT_RELOAD
+		swapReloadedPipelines();
+#endif
+
+		if(m_oitDirty) {
+			rebuildOITPipelines();
+		}
+
+		// the targets are swapchain sized, frames only render into the top left m_renderWidth x m_renderHeight of them
+		m_renderWidth = std::max(static_cast<i32>(m_width * m_renderScale), 1);
+		m_renderHeight = std::max(static_cast<i32>(m_height * m_renderScale), 1);
+
 		f32 orthoSize = std::sqrt(2.0f);
-		glm::mat4 model = glm::rotate(glm::mat4(1.0f), static_cast<f32>(glfwGetTime()), glm::vec3(0.0f, 1.0f, 0.0f)) * m_model.baseTransform;
+		const f64 time = glfwGetTime();
+		const f32 deltaTime = static_cast<f32>(time - m_previousFrameTime);
+		m_previousFrameTime = time;
+
+		glm::mat4 model = glm::rotate(glm::mat4(1.0f), static_cast<f32>(time), glm::vec3(0.0f, 1.0f, 0.0f)) * m_model.baseTransform;
 		glm::mat4 view = glm::lookAt(m_position, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 		glm::mat4 projection = perspective(glm::radians(m_fov / 2.0f), static_cast<f32>(m_width) / static_cast<f32>(m_height), 0.1f);
+		const glm::mat4 cameraTransform = projection * view;
+
+		// shift the samples by a subpixel offset every frame so postprocess.comp can accumulate them, more of them when each output pixel gets fewer framebuffer texels
+		glm::vec2 jitter(0.0f);
+		if(m_temporalAA) {
+			const u32 numJitterPhases = static_cast<u32>(std::ceil(8.0f / (m_renderScale * m_renderScale)));
+			const u32 phase = m_temporalFrame++ % numJitterPhases + 1;
+			jitter = glm::vec2(halton(phase, 2), halton(phase, 3)) - 0.5f;
+			projection[2][0] = -2.0f * jitter.x / m_renderWidth;
+			projection[2][1] = -2.0f * jitter.y / m_renderHeight;
+		}
+
 		glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), m_lightAngle, glm::vec3(0.0f, 1.0f, 0.0f));
 		glm::mat4 lightProjection = ortho(-orthoSize, orthoSize, -orthoSize, orthoSize, -orthoSize, orthoSize);
 		glm::mat4 camMatrixNoTranslation = projection * glm::mat4(glm::mat3(view));
 
+		// transparent fragments only need nodes inside the screen bounds of the blended geometry
+		VkRect2D oitRect = {};
+		if(m_model.numBlendDrawCommands > 0) {
+			oitRect = getScreenRect(projection * view * model, m_model.blendAABB);
+			oitRect.extent.width += oitRect.offset.x % OIT_TILE_SIZE;
+			oitRect.extent.height += oitRect.offset.y % OIT_TILE_SIZE;
+			oitRect.offset.x -= oitRect.offset.x % OIT_TILE_SIZE;
+			oitRect.offset.y -= oitRect.offset.y % OIT_TILE_SIZE;
+			if(!m_oitBuffer.buffer || static_cast<u64>(oitRect.extent.width) * oitRect.extent.height > m_oitBufferPixels) {
+				VkRect2D boundsRect = getScreenRect(projection * view, m_model.blendBounds);
+				createOITResources(std::max(static_cast<u64>(oitRect.extent.width) * oitRect.extent.height, static_cast<u64>(boundsRect.extent.width + OIT_TILE_SIZE - 1) * (boundsRect.extent.height + OIT_TILE_SIZE - 1)));
+			}
+		}
+		const b8 drawBlend = oitRect.extent.width > 0 && oitRect.extent.height > 0;
+		const b8 visibilityPass = m_visibilityBuffer && m_model.visibilityPipeline;
+
 		PushConstants pushConstants = {
 			m_oitBuffer.devicePtr,
 			m_model.vertexBuffer.devicePtr,
+			m_model.instanceBuffer.devicePtr,
 			m_model.materialBuffer.devicePtr,
 			m_poissonDiskBuffer.devicePtr,
 			projection * view,
 			lightProjection* lightView,
 			model,
-			glm::vec4(1.0f),
+			m_clusterBuffer.devicePtr,
 			m_position,
-			m_lightAngle,
-			m_width
+			m_lightAngle
 		};
 
 		auto frameData = m_perFrameData[m_frameIndex];
 		vkWaitForFences(m_device, 1, &frameData.fence, true, std::numeric_limits<u64>::max());
 
+		// this slot's last frame is done, so its timestamps are in and can steer the render scale of the frames after this one
+		// timestamps are only comparable within a queue, so each command buffer is timed on its own and the frame costs their sum
+		// none of them include the semaphore waits in front of them, blocking on presentation or on the other queue isn't GPU work
+		if(frameData.timestampsWritten) {
+			u64 timestamps[m_timestampsPerFrame];
+			vkGetQueryPoolResults(m_device, m_timestampPool, m_frameIndex * m_timestampsPerFrame, m_timestampsPerFrame, sizeof(timestamps), timestamps, sizeof(u64), VK_QUERY_RESULT_64_BIT);
+			u64 ticks = 0;
+			for(u32 i = 0; i < m_timestampsPerFrame; i += 2) {
+				ticks += timestamps[i + 1] - timestamps[i];
+			}
+			const f32 gpuTime = std::max(static_cast<f32>(ticks) * m_timestampPeriod * 1e-9f, 1e-6f);
+
+			// cost goes with pixel count, so the scale follows the square root of how far off budget the frame was, damped so it doesn't chase noise
+			if(m_dynamicResolution) {
+				const f32 targetScale = m_renderScale * std::sqrt(m_gpuTimeBudget / gpuTime);
+				m_renderScale = std::clamp(m_renderScale + (targetScale - m_renderScale) * 0.1f, m_minRenderScale, 1.0f);
+			}
+		}
+
 		u32 imageIndex;
 		VkResult result = vkAcquireNextImageKHR(m_device, m_swapchain, std::numeric_limits<u64>::max(), frameData.acquireSem, nullptr, &imageIndex);
 		if(result == VK_ERROR_OUT_OF_DATE_KHR) {
@@ -40,377 +124,721 @@ void Renderer::run() {
 
 		vkResetFences(m_device, 1, &frameData.fence);
 		vkResetCommandPool(m_device, frameData.cmdPool, 0);
+		vkResetCommandPool(m_device, frameData.computeCmdPool, 0);
 
+		const u64 frameNumber = ++m_frameNumber;
+		const Image& depthTarget = m_depthTargets[frameNumber % 2];
+
+		vkBeginCommandBuffer(frameData.prepassCmdBuffer, ptr(VkCommandBufferBeginInfo{ .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT }));
 		vkBeginCommandBuffer(frameData.cmdBuffer, ptr(VkCommandBufferBeginInfo{ .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT }));
+		vkBeginCommandBuffer(frameData.computeCmdBuffer, ptr(VkCommandBufferBeginInfo{ .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT }));
 
-		vkCmdSetViewport(frameData.cmdBuffer, 0, 1, ptr(VkViewport{ 0.0f, 0.0f, static_cast<f32>(m_shadowMapSize), static_cast<f32>(m_shadowMapSize), 0.0f, 1.0f }));
-		vkCmdSetScissor(frameData.cmdBuffer, 0, 1, ptr(VkRect2D{ { 0, 0 }, { static_cast<u32>(m_shadowMapSize), static_cast<u32>(m_shadowMapSize) } }));
-		
-		vkCmdPipelineBarrier2(frameData.cmdBuffer, ptr(VkDependencyInfo{
-			.imageMemoryBarrierCount = 1,
-			.pImageMemoryBarriers = ptr(VkImageMemoryBarrier2{
-				.srcStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
-				.srcAccessMask = VK_ACCESS_2_SHADER_READ_BIT,
-				.dstStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT,
-				.dstAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-				.newLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
-				.image = m_shadowMap.image,
-				.subresourceRange = depthSubresourceRange()
-			})
-		}));
+		// at all commands each start waits for the submit's semaphores and whatever the queue was still running, so it marks when this work really begins
+		// the compute queries are reset here too, the compute submit waits on this one through the scene timeline
+		const u32 firstTimestamp = m_frameIndex * m_timestampsPerFrame;
+		if(m_gpuTimingSupported) {
+			vkCmdResetQueryPool(frameData.prepassCmdBuffer, m_timestampPool, firstTimestamp, m_timestampsPerFrame);
+			vkCmdWriteTimestamp2(frameData.prepassCmdBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_timestampPool, firstTimestamp);
+			vkCmdWriteTimestamp2(frameData.cmdBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_timestampPool, firstTimestamp + 2);
+			vkCmdWriteTimestamp2(frameData.computeCmdBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_timestampPool, firstTimestamp + 4);
+		}
 
-		vkCmdBeginRendering(frameData.cmdBuffer, ptr(VkRenderingInfo{
-			.renderArea = { 0, 0, { static_cast<u32>(m_shadowMapSize), static_cast<u32>(m_shadowMapSize) } },
-			.layerCount = 1,
-			.pDepthAttachment = ptr(VkRenderingAttachmentInfo{
-				.imageView = m_shadowMap.view,
-				.imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
-				.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-				.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-				.clearValue = { 0.0f }
-			})
-		}));
+		const Image& history = m_historyTargets[m_historyIndex ^ 1];
+		const Image& newHistory = m_historyTargets[m_historyIndex];
 
-		if(m_model.numOpaqueDrawCommands > 0) {
-			vkCmdBindPipeline(frameData.cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_shadowPipeline);
-			vkCmdBindIndexBuffer(frameData.cmdBuffer, m_model.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-			vkCmdPushConstants(frameData.cmdBuffer, m_modelPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants), &pushConstants);
-			vkCmdDrawIndexedIndirect(frameData.cmdBuffer, m_model.indirectBuffer.buffer, 0, m_model.numOpaqueDrawCommands, sizeof(VkDrawIndexedIndirectCommand));
+		// nothing rendered last frame is needed again except the TAA history and the adapted exposure
+		// the attachments are exclusive to the graphics queue, the frame graph moves the ones the post chain reads over to the compute queue
+		const FrameGraph::Resource clusterBuffer = m_frameGraph.importBuffer(m_clusterBuffer.buffer);
+		const FrameGraph::Resource shadowMap = m_frameGraph.importImage(m_shadowMap.image, depthSubresourceRange(), true, m_graphicsQueueFamily);
+		const FrameGraph::Resource depth = m_frameGraph.importImage(depthTarget.image, depthSubresourceRange(), true, m_graphicsQueueFamily);
+		const FrameGraph::Resource visibility = visibilityPass ? m_frameGraph.importImage(m_visibilityTarget.image, colorSubresourceRange(), true, m_graphicsQueueFamily) : 0;
+		const FrameGraph::Resource color = m_frameGraph.importImage(m_colorTarget.image, colorSubresourceRange(), true, m_graphicsQueueFamily);
+		const FrameGraph::Resource oitBuffer = drawBlend ? m_frameGraph.importBuffer(m_oitBuffer.buffer) : 0;
+		const b8 weightedBlended = drawBlend && m_weightedBlendedOIT;
+		const FrameGraph::Resource oitAccum = weightedBlended ? m_frameGraph.importImage(m_oitAccumTarget.image, colorSubresourceRange(), true, m_graphicsQueueFamily) : 0;
+		const FrameGraph::Resource oitRevealage = weightedBlended ? m_frameGraph.importImage(m_oitRevealageTarget.image, colorSubresourceRange(), true, m_graphicsQueueFamily) : 0;
+		const FrameGraph::Resource historyImage = m_frameGraph.importImage(history.image, colorSubresourceRange(), !m_historyValid);
+		const FrameGraph::Resource newHistoryImage = m_frameGraph.importImage(newHistory.image, colorSubresourceRange(), true);
+		std::vector<FrameGraph::Resource> bloomMips;
+		for(u32 i = 0; i < m_bloomMipCount; i++) {
+			bloomMips.push_back(m_frameGraph.importImage(m_bloomTarget.image, VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 }, true));
 		}
+		const FrameGraph::Resource exposureBuffer = m_frameGraph.importBuffer(m_exposureBuffer.buffer);
+		const FrameGraph::Resource swapchain = m_frameGraph.importImage(m_swapchainImages[imageIndex], colorSubresourceRange(), true);
 
-		vkCmdEndRendering(frameData.cmdBuffer);
-
-		vkCmdPipelineBarrier2(frameData.cmdBuffer, ptr(VkDependencyInfo{
-			.imageMemoryBarrierCount = 2,
-			.pImageMemoryBarriers = ptr({
-				VkImageMemoryBarrier2{
-					.srcStageMask = VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
-					.srcAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-					.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
-					.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT,
-					.oldLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
-					.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-					.image = m_shadowMap.image,
-					.subresourceRange = depthSubresourceRange(),
-				},
-				VkImageMemoryBarrier2{
-					.srcStageMask = VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
-					.srcAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-					.dstStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT,
-					.dstAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-					.newLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
-					.image = m_depthTarget.image,
-					.subresourceRange = depthSubresourceRange()
-				}
-			})
-		}));
+		m_frameGraph.markOutput(newHistoryImage);
+		m_frameGraph.markOutput(exposureBuffer);
+		m_frameGraph.markOutput(swapchain, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
 
-		vkCmdSetViewport(frameData.cmdBuffer, 0, 1, ptr(VkViewport{ 0.0f, 0.0f, static_cast<f32>(m_width), static_cast<f32>(m_height), 0.0f, 1.0f }));
-		vkCmdSetScissor(frameData.cmdBuffer, 0, 1, ptr(VkRect2D{ { 0, 0 }, { static_cast<u32>(m_width), static_cast<u32>(m_height) } }));
-
-		vkCmdBeginRendering(frameData.cmdBuffer, ptr(VkRenderingInfo{
-			.renderArea = { 0, 0, { static_cast<u32>(m_width), static_cast<u32>(m_height) } },
-			.layerCount = 1,
-			.pDepthAttachment = ptr(VkRenderingAttachmentInfo{
-				.imageView = m_depthTarget.view,
-				.imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
-				.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-				.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-				.clearValue = { 0.0f }
-			})
-		}));
+		// lights, shadows and depth, none of which the previous frame's post chain is still reading
+		m_frameGraph.addSegment(frameData.prepassCmdBuffer, m_graphicsQueueFamily);
+
+		// bin the punctual lights into view space clusters
+		m_frameGraph.addPass({
+			{ clusterBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT }
+		}, [&](VkCommandBuffer cmd) {
+			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_clusterPipeline);
+			vkCmdPushConstants(cmd, m_clusterPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ClusterPushConstants), ptr(ClusterPushConstants{
+				m_clusterBuffer.devicePtr,
+				m_model.lightBuffer.devicePtr,
+				view * model,
+				glm::vec4(1.0f),
+				glm::vec2(projection[0][0], projection[1][1]),
+				static_cast<u32>(m_model.numLights),
+				static_cast<u32>(m_renderWidth),
+				static_cast<u32>(m_renderHeight)
+			}));
+			vkCmdDispatch(cmd, CLUSTER_COUNT_Z, 1, 1);
+		});
+
+		m_frameGraph.addPass({
+			{ shadowMap, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL }
+		}, [&](VkCommandBuffer cmd) {
+			vkCmdSetViewport(cmd, 0, 1, ptr(VkViewport{ 0.0f, 0.0f, static_cast<f32>(m_shadowMapSize), static_cast<f32>(m_shadowMapSize), 0.0f, 1.0f }));
+			vkCmdSetScissor(cmd, 0, 1, ptr(VkRect2D{ { 0, 0 }, { static_cast<u32>(m_shadowMapSize), static_cast<u32>(m_shadowMapSize) } }));
 
-		if(m_model.numOpaqueDrawCommands > 0) {
-			vkCmdBindPipeline(frameData.cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_prepassPipeline);
-			vkCmdDrawIndexedIndirect(frameData.cmdBuffer, m_model.indirectBuffer.buffer, 0, m_model.numOpaqueDrawCommands, sizeof(VkDrawIndexedIndirectCommand));
+			vkCmdBeginRendering(cmd, ptr(VkRenderingInfo{
+				.renderArea = { 0, 0, { static_cast<u32>(m_shadowMapSize), static_cast<u32>(m_shadowMapSize) } },
+				.layerCount = 1,
+				.pDepthAttachment = ptr(VkRenderingAttachmentInfo{
+					.imageView = m_shadowMap.view,
+					.imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+					.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+					.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+					.clearValue = { 0.0f }
+				})
+			}));
+
+			if(m_model.numOpaqueDrawCommands > 0) {
+				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_shadowPipeline);
+				vkCmdBindIndexBuffer(cmd, m_model.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+				vkCmdPushConstants(cmd, m_modelPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants), &pushConstants);
+				vkCmdDrawIndexedIndirect(cmd, m_model.indirectBuffer.buffer, 0, m_model.numOpaqueDrawCommands - m_model.numAlphaTestedDrawCommands, sizeof(VkDrawIndexedIndirectCommand));
+			}
+
+			// alpha tested draws come last, with a fragment shader that drops what the cutoff removes
+			if(m_model.numAlphaTestedDrawCommands > 0) {
+				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_alphaTestShadowPipeline);
+				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_modelPipelineLayout, 0, 1, &m_model.texSet, 0, nullptr);
+				vkCmdDrawIndexedIndirect(cmd, m_model.indirectBuffer.buffer, (m_model.numOpaqueDrawCommands - m_model.numAlphaTestedDrawCommands) * sizeof(VkDrawIndexedIndirectCommand), m_model.numAlphaTestedDrawCommands, sizeof(VkDrawIndexedIndirectCommand));
+			}
+
+			vkCmdEndRendering(cmd);
+		});
+
+		std::vector<FrameGraph::Access> prepassAccesses = {
+			{ depth, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL }
+		};
+		if(visibilityPass) {
+			prepassAccesses.push_back({ visibility, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
 		}
+		m_frameGraph.addPass(prepassAccesses, [&](VkCommandBuffer cmd) {
+			vkCmdSetViewport(cmd, 0, 1, ptr(VkViewport{ 0.0f, 0.0f, static_cast<f32>(m_renderWidth), static_cast<f32>(m_renderHeight), 0.0f, 1.0f }));
+			vkCmdSetScissor(cmd, 0, 1, ptr(VkRect2D{ { 0, 0 }, { static_cast<u32>(m_renderWidth), static_cast<u32>(m_renderHeight) } }));
 
-		vkCmdEndRendering(frameData.cmdBuffer);
-
-		vkCmdPipelineBarrier2(frameData.cmdBuffer, ptr(VkDependencyInfo{
-			.imageMemoryBarrierCount = 2,
-			.pImageMemoryBarriers = ptr({
-				VkImageMemoryBarrier2{
-					.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
-					.srcAccessMask = VK_ACCESS_2_SHADER_READ_BIT,
-					.dstStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-					.dstAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-					.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-					.image = m_colorTarget.image,
-					.subresourceRange = colorSubresourceRange()
-				},
-				VkImageMemoryBarrier2{
-					.srcStageMask = VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
-					.srcAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-					.dstStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT,
-					.dstAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
-					.oldLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
-					.newLayout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
-					.image = m_depthTarget.image,
-					.subresourceRange = depthSubresourceRange()
-				}
-			})
-		}));
+			// in visibility buffer mode the prepass also writes which triangle covers each pixel
+			vkCmdBeginRendering(cmd, ptr(VkRenderingInfo{
+				.renderArea = { 0, 0, { static_cast<u32>(m_renderWidth), static_cast<u32>(m_renderHeight) } },
+				.layerCount = 1,
+				.colorAttachmentCount = visibilityPass ? 1u : 0u,
+				.pColorAttachments = ptr(VkRenderingAttachmentInfo{
+					.imageView = m_visibilityTarget.view,
+					.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+					.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+					.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+					.clearValue = { .color = { .uint32 = { VISIBILITY_EMPTY } } }
+				}),
+				.pDepthAttachment = ptr(VkRenderingAttachmentInfo{
+					.imageView = depthTarget.view,
+					.imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+					.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+					.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+					.clearValue = { 0.0f }
+				})
+			}));
 
-		vkCmdBeginRendering(frameData.cmdBuffer, ptr(VkRenderingInfo{
-			.renderArea = { 0, 0, { static_cast<u32>(m_width), static_cast<u32>(m_height) } },
-			.layerCount = 1,
-			.colorAttachmentCount = 1,
-			.pColorAttachments = ptr(VkRenderingAttachmentInfo{
-				.imageView = m_colorTarget.view,
-				.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-				.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-				.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-				.clearValue = { 0.0f, 0.0f, 0.0f, 1.0f }
-			}),
-			.pDepthAttachment = ptr(VkRenderingAttachmentInfo{
-				.imageView = m_depthTarget.view,
-				.imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
-				.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
-				.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-			})
-		}));
+			if(m_model.numOpaqueDrawCommands > 0) {
+				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, visibilityPass ? m_model.visibilityPipeline : m_prepassPipeline);
+				vkCmdDrawIndexedIndirect(cmd, m_model.indirectBuffer.buffer, 0, m_model.numOpaqueDrawCommands - m_model.numAlphaTestedDrawCommands, sizeof(VkDrawIndexedIndirectCommand));
+			}
 
-		if(m_model.numOpaqueDrawCommands > 0) {
-			vkCmdBindPipeline(frameData.cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_opaquePipeline);
-			vkCmdBindDescriptorSets(frameData.cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_modelPipelineLayout, 0, 1, &m_model.texSet, 0, nullptr);
-			vkCmdPushDescriptorSet(frameData.cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_modelPipelineLayout, 1, 4, ptr({
-				VkWriteDescriptorSet{
+			if(m_model.numAlphaTestedDrawCommands > 0) {
+				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_alphaTestPrepassPipeline);
+				vkCmdDrawIndexedIndirect(cmd, m_model.indirectBuffer.buffer, (m_model.numOpaqueDrawCommands - m_model.numAlphaTestedDrawCommands) * sizeof(VkDrawIndexedIndirectCommand), m_model.numAlphaTestedDrawCommands, sizeof(VkDrawIndexedIndirectCommand));
+			}
+
+			vkCmdEndRendering(cmd);
+		});
+
+		// from here on the framebuffer and OIT state get overwritten, which has to wait until the previous frame's post chain is done with them
+		m_frameGraph.addSegment(frameData.cmdBuffer, m_graphicsQueueFamily);
+
+		// shades every pixel exactly once from the ids, rebuilding what opaque.frag gets as varyings from the vertex buffer
+		if(visibilityPass) {
+			m_frameGraph.addPass({
+				{ visibility, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL },
+				{ color, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL },
+				{ shadowMap, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+				{ clusterBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT }
+			}, [&](VkCommandBuffer cmd) {
+				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_model.materialPipeline);
+				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_materialPipelineLayout, 0, 1, &m_model.texSet, 0, nullptr);
+				vkCmdPushDescriptorSet(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_materialPipelineLayout, 1, 6, ptr({
+					VkWriteDescriptorSet{
+						.descriptorCount = 1,
+						.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+						.pImageInfo = ptr(VkDescriptorImageInfo{
+							.sampler = m_skyboxSampler,
+							.imageView = m_skybox.irradianceMap.view,
+							.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+						})
+					},
+					VkWriteDescriptorSet{
+						.dstBinding = 1,
+						.descriptorCount = 1,
+						.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+						.pImageInfo = ptr(VkDescriptorImageInfo{
+							.sampler = m_skyboxSampler,
+							.imageView = m_skybox.radianceMap.view,
+							.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+						})
+					},
+					VkWriteDescriptorSet{
+						.dstBinding = 2,
+						.descriptorCount = 1,
+						.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+						.pImageInfo = ptr(VkDescriptorImageInfo{
+							.sampler = m_skyboxSampler,
+							.imageView = m_brdfIntegralTex.view,
+							.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+						})
+					},
+					VkWriteDescriptorSet{
+						.dstBinding = 3,
+						.descriptorCount = 1,
+						.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+						.pImageInfo = ptr(VkDescriptorImageInfo{
+							.sampler = m_shadowSampler,
+							.imageView = m_shadowMap.view,
+							.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+						})
+					},
+					VkWriteDescriptorSet{
+						.dstBinding = 4,
+						.descriptorCount = 2,
+						.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+						.pImageInfo = ptr({
+							VkDescriptorImageInfo{
+								.imageView = m_visibilityTarget.view,
+								.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+							},
+							VkDescriptorImageInfo{
+								.imageView = m_colorTarget.view,
+								.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+							}
+						})
+					}
+				}));
+
+				vkCmdPushConstants(cmd, m_materialPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MaterialPassConstants), ptr(MaterialPassConstants{
+					.drawCommandBuffer = m_model.indirectBuffer.devicePtr,
+					.vertexBuffer = pushConstants.vertexBuffer,
+					.instanceBuffer = pushConstants.instanceBuffer,
+					.materialBuffer = pushConstants.materialBuffer,
+					.poissonDiskBuffer = pushConstants.poissonDiskBuffer,
+					.cameraTransform = pushConstants.cameraTransform,
+					.lightTransform = pushConstants.lightTransform,
+					.modelTransform = pushConstants.modelTransform,
+					.clusterBuffer = pushConstants.clusterBuffer,
+					.camPos = pushConstants.camPos,
+					.lightAngle = pushConstants.lightAngle,
+					.indexBuffer = m_model.indexBuffer.devicePtr
+				}));
+				vkCmdDispatch(cmd, (m_renderWidth + 7) / 8, (m_renderHeight + 7) / 8, 1);
+			});
+		}
+
+		m_frameGraph.addPass({
+			{ color, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, visibilityPass ? VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT : VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+			{ depth, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL },
+			{ shadowMap, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+			{ clusterBuffer, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT }
+		}, [&](VkCommandBuffer cmd) {
+			vkCmdBeginRendering(cmd, ptr(VkRenderingInfo{
+				.renderArea = { 0, 0, { static_cast<u32>(m_renderWidth), static_cast<u32>(m_renderHeight) } },
+				.layerCount = 1,
+				.colorAttachmentCount = 1,
+				.pColorAttachments = ptr(VkRenderingAttachmentInfo{
+					.imageView = m_colorTarget.view,
+					.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+					.loadOp = visibilityPass ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR,
+					.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+					.clearValue = { 0.0f, 0.0f, 0.0f, 1.0f }
+				}),
+				.pDepthAttachment = ptr(VkRenderingAttachmentInfo{
+					.imageView = depthTarget.view,
+					.imageLayout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
+					.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+					.storeOp = VK_ATTACHMENT_STORE_OP_NONE,
+				})
+			}));
+
+			if(m_model.numOpaqueDrawCommands > 0 && !visibilityPass) {
+				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_modelPipelineLayout, 0, 1, &m_model.texSet, 0, nullptr);
+				vkCmdPushDescriptorSet(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_modelPipelineLayout, 1, 4, ptr({
+					VkWriteDescriptorSet{
+						.descriptorCount = 1,
+						.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+						.pImageInfo = ptr(VkDescriptorImageInfo{
+							.sampler = m_skyboxSampler,
+							.imageView = m_skybox.irradianceMap.view,
+							.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+						})
+					},
+					VkWriteDescriptorSet{
+						.dstBinding = 1,
+						.descriptorCount = 1,
+						.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+						.pImageInfo = ptr(VkDescriptorImageInfo{
+							.sampler = m_skyboxSampler,
+							.imageView = m_skybox.radianceMap.view,
+							.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+						})
+					},
+					VkWriteDescriptorSet{
+						.dstBinding = 2,
+						.descriptorCount = 1,
+						.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+						.pImageInfo = ptr(VkDescriptorImageInfo{
+							.sampler = m_skyboxSampler,
+							.imageView = m_brdfIntegralTex.view,
+							.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+						})
+					},
+					VkWriteDescriptorSet{
+						.dstBinding = 3,
+						.descriptorCount = 1,
+						.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+						.pImageInfo = ptr(VkDescriptorImageInfo{
+							.sampler = m_shadowSampler,
+							.imageView = m_shadowMap.view,
+							.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+						})
+					}
+				}));
+				for(const MaterialPermutation& permutation : m_model.opaquePermutations) {
+					vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, permutation.pipeline);
+					vkCmdDrawIndexedIndirect(cmd, m_model.indirectBuffer.buffer, permutation.firstDrawCommand * sizeof(VkDrawIndexedIndirectCommand), permutation.numDrawCommands, sizeof(VkDrawIndexedIndirectCommand));
+				}
+			}
+
+			if(m_skybox.environmentMap.image != VkImage{}) {
+				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_skyboxPipeline);
+				vkCmdPushDescriptorSet(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_skyboxPipelineLayout, 0, 1, ptr(VkWriteDescriptorSet{
 					.descriptorCount = 1,
 					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 					.pImageInfo = ptr(VkDescriptorImageInfo{
 						.sampler = m_skyboxSampler,
-						.imageView = m_skybox.irradianceMap.view,
+						.imageView = m_skybox.environmentMap.view,
 						.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
 					})
-				},
-				VkWriteDescriptorSet{
-					.dstBinding = 1,
-					.descriptorCount = 1,
-					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-					.pImageInfo = ptr(VkDescriptorImageInfo{
-						.sampler = m_skyboxSampler,
-						.imageView = m_skybox.radianceMap.view,
-						.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+				}));
+				vkCmdPushConstants(cmd, m_skyboxPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &camMatrixNoTranslation);
+				vkCmdDraw(cmd, 36, 1, 0, 0);
+			}
+
+			vkCmdEndRendering(cmd);
+		});
+
+		if(drawBlend) {
+			m_frameGraph.addPass({
+				{ oitBuffer, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT }
+			}, [&](VkCommandBuffer cmd) {
+				vkCmdUpdateBuffer(cmd, m_oitBuffer.buffer, 0, sizeof(OITBufferHeader), ptr(OITBufferHeader{
+					static_cast<u32>(oitRect.offset.x),
+					static_cast<u32>(oitRect.offset.y),
+					oitRect.extent.width,
+					oitRect.extent.height,
+					m_oitBuffer.devicePtr + m_oitTileMaskOffset
+				}));
+				vkCmdFillBuffer(cmd, m_oitBuffer.buffer, m_oitTileMaskOffset, m_oitTileMaskSize, 0);
+			});
+
+			std::vector<FrameGraph::Access> blendAccesses = {
+				{ oitBuffer, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT },
+				{ depth, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL },
+				{ shadowMap, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+				{ clusterBuffer, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT }
+			};
+			if(weightedBlended) {
+				blendAccesses.push_back({ oitAccum, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+				blendAccesses.push_back({ oitRevealage, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+			}
+			m_frameGraph.addPass(blendAccesses, [&](VkCommandBuffer cmd) {
+				// nothing transparent lands outside the OIT rect, so the pass (and the weighted blended clears) can be confined to it
+				vkCmdSetScissor(cmd, 0, 1, &oitRect);
+				vkCmdBeginRendering(cmd, ptr(VkRenderingInfo{
+					.renderArea = oitRect,
+					.layerCount = 1,
+					.colorAttachmentCount = m_weightedBlendedOIT ? 2u : 0u,
+					.pColorAttachments = ptr({
+						VkRenderingAttachmentInfo{
+							.imageView = m_oitAccumTarget.view,
+							.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+							.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+							.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+							.clearValue = { .color = { 0.0f, 0.0f, 0.0f, 0.0f } }
+						},
+						VkRenderingAttachmentInfo{
+							.imageView = m_oitRevealageTarget.view,
+							.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+							.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+							.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+							.clearValue = { .color = { 1.0f, 1.0f, 1.0f, 1.0f } }
+						}
+					}),
+					.pDepthAttachment = ptr(VkRenderingAttachmentInfo{
+						.imageView = depthTarget.view,
+						.imageLayout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
+						.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+						.storeOp = VK_ATTACHMENT_STORE_OP_NONE,
 					})
-				},
+				}));
+		
+				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_modelPipelineLayout, 0, 1, &m_model.texSet, 0, nullptr);
+				vkCmdPushDescriptorSet(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_modelPipelineLayout, 1, 4, ptr({
+					VkWriteDescriptorSet{
+						.descriptorCount = 1,
+						.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+						.pImageInfo = ptr(VkDescriptorImageInfo{
+							.sampler = m_skyboxSampler,
+							.imageView = m_skybox.irradianceMap.view,
+							.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+						})
+					},
+					VkWriteDescriptorSet{
+						.dstBinding = 1,
+						.descriptorCount = 1,
+						.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+						.pImageInfo = ptr(VkDescriptorImageInfo{
+							.sampler = m_skyboxSampler,
+							.imageView = m_skybox.radianceMap.view,
+							.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+						})
+					},
+					VkWriteDescriptorSet{
+						.dstBinding = 2,
+						.descriptorCount = 1,
+						.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+						.pImageInfo = ptr(VkDescriptorImageInfo{
+							.sampler = m_skyboxSampler,
+							.imageView = m_brdfIntegralTex.view,
+							.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+						})
+					},
+					VkWriteDescriptorSet{
+						.dstBinding = 3,
+						.descriptorCount = 1,
+						.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+						.pImageInfo = ptr(VkDescriptorImageInfo{
+							.sampler = m_shadowSampler,
+							.imageView = m_shadowMap.view,
+							.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+						})
+					}
+				}));
+				vkCmdPushConstants(cmd, m_modelPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants), &pushConstants);
+		
+				for(const MaterialPermutation& permutation : m_model.blendPermutations) {
+					vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, permutation.pipeline);
+					vkCmdDrawIndexedIndirect(cmd, m_model.indirectBuffer.buffer, (m_model.numOpaqueDrawCommands + permutation.firstDrawCommand) * sizeof(VkDrawIndexedIndirectCommand), permutation.numDrawCommands, sizeof(VkDrawIndexedIndirectCommand));
+				}
+		
+				vkCmdEndRendering(cmd);
+			});
+		}
+
+		// OIT resolve, TAA, bloom and tone mapping run on the compute queue, overlapping the next frame's shadows and prepass
+		m_frameGraph.addSegment(frameData.computeCmdBuffer, m_computeQueueFamily);
+
+		// composites the transparent fragments onto the framebuffer, only over the OIT rect
+		if(drawBlend) {
+			std::vector<FrameGraph::Access> resolveAccesses = {
+				{ color, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL },
+				{ oitBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT }
+			};
+			if(weightedBlended) {
+				resolveAccesses.push_back({ oitAccum, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL });
+				resolveAccesses.push_back({ oitRevealage, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL });
+			}
+			m_frameGraph.addPass(resolveAccesses, [&](VkCommandBuffer cmd) {
+				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_oitResolvePipeline);
+				vkCmdPushConstants(cmd, m_oitResolvePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(VkDeviceAddress), &m_oitBuffer.devicePtr);
+				vkCmdPushDescriptorSet(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_oitResolvePipelineLayout, 0, 1, ptr(VkWriteDescriptorSet{
+					.descriptorCount = 3,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+					.pImageInfo = ptr({
+						VkDescriptorImageInfo{
+							.imageView = m_colorTarget.view,
+							.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+						},
+						VkDescriptorImageInfo{
+							.imageView = m_oitAccumTarget.view,
+							.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+						},
+						VkDescriptorImageInfo{
+							.imageView = m_oitRevealageTarget.view,
+							.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+						}
+					})
+				}));
+				vkCmdDispatch(cmd, (oitRect.extent.width + OIT_TILE_SIZE - 1) / OIT_TILE_SIZE, (oitRect.extent.height + OIT_TILE_SIZE - 1) / OIT_TILE_SIZE, 1);
+			});
+		}
+
+		// reconstructs the swapchain sized image from the framebuffer and the history, which is reprojected by rebuilding each pixel's position from depth
+		// the model is the only thing that moves besides the camera, so its transforms are all the motion vectors there are
+		m_frameGraph.addPass({
+			{ color, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_GENERAL },
+			{ depth, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL },
+			{ historyImage, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_GENERAL },
+			{ newHistoryImage, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL }
+		}, [&](VkCommandBuffer cmd) {
+			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_postprocessingPipeline);
+			vkCmdPushConstants(cmd, m_postprocessingPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PostprocessPushConstants), ptr(PostprocessPushConstants{
+				m_previousCameraTransform * m_previousModelTransform * glm::inverse(cameraTransform * model),
+				m_previousCameraTransform * glm::inverse(cameraTransform),
+				jitter,
+				m_temporalAA && m_historyValid ? 0.9f : 0.0f,
+				static_cast<u32>(m_renderWidth),
+				static_cast<u32>(m_renderHeight)
+			}));
+
+			vkCmdPushDescriptorSet(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_postprocessingPipelineLayout, 0, 2, ptr({
 				VkWriteDescriptorSet{
-					.dstBinding = 2,
-					.descriptorCount = 1,
+					.descriptorCount = 3,
 					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-					.pImageInfo = ptr(VkDescriptorImageInfo{
-						.sampler = m_skyboxSampler,
-						.imageView = m_brdfIntegralTex.view,
-						.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+					.pImageInfo = ptr({
+						VkDescriptorImageInfo{
+							.sampler = m_postprocessingSampler,
+							.imageView = m_colorTarget.view,
+							.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+						},
+						VkDescriptorImageInfo{
+							.sampler = m_postprocessingSampler,
+							.imageView = depthTarget.view,
+							.imageLayout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL
+						},
+						VkDescriptorImageInfo{
+							.sampler = m_postprocessingSampler,
+							.imageView = history.view,
+							.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+						}
 					})
 				},
 				VkWriteDescriptorSet{
 					.dstBinding = 3,
 					.descriptorCount = 1,
-					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
 					.pImageInfo = ptr(VkDescriptorImageInfo{
-						.sampler = m_shadowSampler,
-						.imageView = m_shadowMap.view,
-						.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+						.imageView = newHistory.view,
+						.imageLayout = VK_IMAGE_LAYOUT_GENERAL
 					})
 				}
 			}));
-			vkCmdDrawIndexedIndirect(frameData.cmdBuffer, m_model.indirectBuffer.buffer, 0, m_model.numOpaqueDrawCommands, sizeof(VkDrawIndexedIndirectCommand));
-		}
+		
+			vkCmdDispatch(cmd, (m_width + 7) / 8, (m_height + 7) / 8, 1);
+		});
 
-		if(m_skybox.environmentMap.image != VkImage{}) {
-			vkCmdBindPipeline(frameData.cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_skyboxPipeline);
-			vkCmdPushDescriptorSet(frameData.cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_skyboxPipelineLayout, 0, 1, ptr(VkWriteDescriptorSet{
-				.descriptorCount = 1,
-				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-				.pImageInfo = ptr(VkDescriptorImageInfo{
-					.sampler = m_skyboxSampler,
-					.imageView = m_skybox.environmentMap.view,
-					.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-				})
-			}));
-			vkCmdPushConstants(frameData.cmdBuffer, m_skyboxPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &camMatrixNoTranslation);
-			vkCmdDraw(frameData.cmdBuffer, 36, 1, 0, 0);
+		// the whole bloom pyramid down in one dispatch, which also builds the luminance histogram and adapts the exposure to it
+		std::vector<FrameGraph::Access> downAccesses = {
+			{ newHistoryImage, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_GENERAL },
+			{ exposureBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT }
+		};
+		for(FrameGraph::Resource mip : bloomMips) {
+			downAccesses.push_back({ mip, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL });
 		}
+		m_frameGraph.addPass(downAccesses, [&](VkCommandBuffer cmd) {
+			// levels a small window's pyramid doesn't have stay null, the shader's stores to them are dropped
+			std::array<VkDescriptorImageInfo, BLOOM_MIP_COUNT> mipInfos = {};
+			for(u32 i = 0; i < m_bloomMipCount; i++) {
+				mipInfos[i] = VkDescriptorImageInfo{ .imageView = m_bloomMipViews[i], .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+			}
 
-		vkCmdEndRendering(frameData.cmdBuffer);
-
-		if(m_model.numBlendDrawCommands > 0) {
-			vkCmdPipelineBarrier2(frameData.cmdBuffer, ptr(VkDependencyInfo{
-				.bufferMemoryBarrierCount = 1,
-				.pBufferMemoryBarriers = ptr(VkBufferMemoryBarrier2{
-					.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
-					.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
-					.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
-					.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
-					.buffer = m_oitBuffer.buffer,
-					.size = VK_WHOLE_SIZE
-				})
-			}));
-		
-			vkCmdBeginRendering(frameData.cmdBuffer, ptr(VkRenderingInfo{
-				.renderArea = { 0, 0, { static_cast<u32>(m_width), static_cast<u32>(m_height) } },
-				.layerCount = 1,
-				.pDepthAttachment = ptr(VkRenderingAttachmentInfo{
-					.imageView = m_depthTarget.view,
-					.imageLayout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
-					.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
-					.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-				})
-			}));
-		
-			vkCmdBindPipeline(frameData.cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_blendPipeline);
-		
-			vkCmdBindDescriptorSets(frameData.cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_modelPipelineLayout, 0, 1, &m_model.texSet, 0, nullptr);
-			vkCmdPushDescriptorSet(frameData.cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_modelPipelineLayout, 1, 4, ptr({
+			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_bloomDownPipeline);
+			vkCmdPushConstants(cmd, m_bloomPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(BloomPushConstants), ptr(BloomPushConstants{ m_exposureBuffer.devicePtr, deltaTime }));
+			vkCmdPushDescriptorSet(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_bloomPipelineLayout, 0, 2, ptr({
 				VkWriteDescriptorSet{
 					.descriptorCount = 1,
 					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 					.pImageInfo = ptr(VkDescriptorImageInfo{
-						.sampler = m_skyboxSampler,
-						.imageView = m_skybox.irradianceMap.view,
-						.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+						.sampler = m_postprocessingSampler,
+						.imageView = newHistory.view,
+						.imageLayout = VK_IMAGE_LAYOUT_GENERAL
 					})
 				},
 				VkWriteDescriptorSet{
 					.dstBinding = 1,
-					.descriptorCount = 1,
-					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-					.pImageInfo = ptr(VkDescriptorImageInfo{
-						.sampler = m_skyboxSampler,
-						.imageView = m_skybox.radianceMap.view,
-						.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-					})
-				},
+					.descriptorCount = BLOOM_MIP_COUNT,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+					.pImageInfo = mipInfos.data()
+				}
+			}));
+			// a workgroup covers 64x64 texels of the first level
+			vkCmdDispatch(cmd, (std::max(m_width / 2, 1) + 63) / 64, (std::max(m_height / 2, 1) + 63) / 64, 1);
+		});
+
+		// and back up, each level adding the one below it, except the first which tonemap.comp upsamples itself
+		for(u32 i = m_bloomMipCount - 1; i > 0; i--) {
+			m_frameGraph.addPass({
+				{ bloomMips[i], VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_GENERAL },
+				{ bloomMips[i - 1], VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL }
+			}, [&, i](VkCommandBuffer cmd) {
+				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_bloomUpPipeline);
+				vkCmdPushDescriptorSet(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_oneTexOneImagePipelineLayout, 0, 2, ptr({
+					VkWriteDescriptorSet{
+						.descriptorCount = 1,
+						.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+						.pImageInfo = ptr(VkDescriptorImageInfo{
+							.sampler = m_postprocessingSampler,
+							.imageView = m_bloomMipViews[i],
+							.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+						})
+					},
+					VkWriteDescriptorSet{
+						.dstBinding = 1,
+						.descriptorCount = 1,
+						.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+						.pImageInfo = ptr(VkDescriptorImageInfo{
+							.imageView = m_bloomMipViews[i - 1],
+							.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+						})
+					}
+				}));
+				vkCmdDispatch(cmd, (std::max(m_width / 2 >> (i - 1), 1) + 7) / 8, (std::max(m_height / 2 >> (i - 1), 1) + 7) / 8, 1);
+			});
+		}
+
+		m_frameGraph.addPass({
+			{ newHistoryImage, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_GENERAL },
+			{ bloomMips[0], VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_GENERAL },
+			{ exposureBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT },
+			{ swapchain, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL }
+		}, [&](VkCommandBuffer cmd) {
+			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_tonemapPipeline);
+			vkCmdPushConstants(cmd, m_tonemapPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(VkDeviceAddress), &m_exposureBuffer.devicePtr);
+			vkCmdPushDescriptorSet(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_tonemapPipelineLayout, 0, 2, ptr({
 				VkWriteDescriptorSet{
-					.dstBinding = 2,
-					.descriptorCount = 1,
+					.descriptorCount = 2,
 					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-					.pImageInfo = ptr(VkDescriptorImageInfo{
-						.sampler = m_skyboxSampler,
-						.imageView = m_brdfIntegralTex.view,
-						.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+					.pImageInfo = ptr({
+						VkDescriptorImageInfo{
+							.sampler = m_postprocessingSampler,
+							.imageView = newHistory.view,
+							.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+						},
+						VkDescriptorImageInfo{
+							.sampler = m_postprocessingSampler,
+							.imageView = m_bloomMipViews[0],
+							.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+						}
 					})
 				},
 				VkWriteDescriptorSet{
-					.dstBinding = 3,
+					.dstBinding = 2,
 					.descriptorCount = 1,
-					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
 					.pImageInfo = ptr(VkDescriptorImageInfo{
-						.sampler = m_shadowSampler,
-						.imageView = m_shadowMap.view,
-						.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+						.imageView = m_swapchainImageViews[imageIndex],
+						.imageLayout = VK_IMAGE_LAYOUT_GENERAL
 					})
 				}
 			}));
-			vkCmdPushConstants(frameData.cmdBuffer, m_modelPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants), &pushConstants);
-		
-			vkCmdDrawIndexedIndirect(frameData.cmdBuffer, m_model.indirectBuffer.buffer, m_model.numOpaqueDrawCommands * sizeof(VkDrawIndexedIndirectCommand), m_model.numBlendDrawCommands, sizeof(VkDrawIndexedIndirectCommand));
-		
-			vkCmdEndRendering(frameData.cmdBuffer);
-		
-			vkCmdPipelineBarrier2(frameData.cmdBuffer, ptr(VkDependencyInfo{
-				.bufferMemoryBarrierCount = 1,
-				.pBufferMemoryBarriers = ptr(VkBufferMemoryBarrier2{
-					.srcStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
-					.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
-					.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
-					.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
-					.buffer = m_oitBuffer.buffer,
-					.size = VK_WHOLE_SIZE
-				}),
-			}));
+			vkCmdDispatch(cmd, (m_width + 7) / 8, (m_height + 7) / 8, 1);
+		});
+
+		m_frameGraph.execute();
+
+		m_previousCameraTransform = cameraTransform;
+		m_previousModelTransform = model;
+		m_historyValid = true;
+		m_historyIndex ^= 1;
+
+		if(m_gpuTimingSupported) {
+			vkCmdWriteTimestamp2(frameData.prepassCmdBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_timestampPool, firstTimestamp + 1);
+			vkCmdWriteTimestamp2(frameData.cmdBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_timestampPool, firstTimestamp + 3);
+			vkCmdWriteTimestamp2(frameData.computeCmdBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_timestampPool, firstTimestamp + 5);
+			m_perFrameData[m_frameIndex].timestampsWritten = true;
 		}
-		else {
-			vkCmdPipelineBarrier2(frameData.cmdBuffer, ptr(VkDependencyInfo{
-				.bufferMemoryBarrierCount = 1,
-				.pBufferMemoryBarriers = ptr(VkBufferMemoryBarrier2{
-					.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
-					.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
-					.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
-					.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
-					.buffer = m_oitBuffer.buffer,
-					.size = VK_WHOLE_SIZE
+
+		vkEndCommandBuffer(frameData.prepassCmdBuffer);
+		vkEndCommandBuffer(frameData.cmdBuffer);
+		vkEndCommandBuffer(frameData.computeCmdBuffer);
+
+		// the prepass only needs the post chain two frames back to be done sampling this frame's depth target, the rest needs the previous one to be done entirely
+		vkQueueSubmit2(m_graphicsQueue, 2, ptr({
+			VkSubmitInfo2{
+				.waitSemaphoreInfoCount = 1,
+				.pWaitSemaphoreInfos = ptr(VkSemaphoreSubmitInfo{
+					.semaphore = m_postTimeline,
+					.value = frameNumber - 2,
+					.stageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT
 				}),
-			}));
-		}
+				.commandBufferInfoCount = 1,
+				.pCommandBufferInfos = ptr(VkCommandBufferSubmitInfo{ .commandBuffer = frameData.prepassCmdBuffer })
+			},
+			VkSubmitInfo2{
+				.waitSemaphoreInfoCount = 1,
+				.pWaitSemaphoreInfos = ptr(VkSemaphoreSubmitInfo{
+					.semaphore = m_postTimeline,
+					.value = frameNumber - 1,
+					.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT
+				}),
+				.commandBufferInfoCount = 1,
+				.pCommandBufferInfos = ptr(VkCommandBufferSubmitInfo{ .commandBuffer = frameData.cmdBuffer }),
+				.signalSemaphoreInfoCount = 1,
+				.pSignalSemaphoreInfos = ptr(VkSemaphoreSubmitInfo{
+					.semaphore = m_sceneTimeline,
+					.value = frameNumber,
+					.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT
+				})
+			}
+		}), nullptr);
 
-		vkCmdPipelineBarrier2(frameData.cmdBuffer, ptr(VkDependencyInfo{
-			.imageMemoryBarrierCount = 2,
-			.pImageMemoryBarriers = ptr({
-				VkImageMemoryBarrier2{
-					.srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-					.srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-					.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
-					.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT,
-					.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-					.newLayout = VK_IMAGE_LAYOUT_GENERAL,
-					.image = m_colorTarget.image,
-					.subresourceRange = colorSubresourceRange()
+		vkQueueSubmit2(m_computeQueue, 1, ptr(VkSubmitInfo2{
+			.waitSemaphoreInfoCount = 2,
+			.pWaitSemaphoreInfos = ptr({
+				VkSemaphoreSubmitInfo{
+					.semaphore = frameData.acquireSem,
+					.stageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
 				},
-				VkImageMemoryBarrier2{
-					.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
-					.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
-					.dstAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
-					.newLayout = VK_IMAGE_LAYOUT_GENERAL,
-					.image = m_swapchainImages[imageIndex],
-					.subresourceRange = colorSubresourceRange()
+				VkSemaphoreSubmitInfo{
+					.semaphore = m_sceneTimeline,
+					.value = frameNumber,
+					.stageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
 				}
-			})
-		}));
-		
-		vkCmdBindPipeline(frameData.cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_postprocessingPipeline);
-
-		VkDeviceAddress postprocessingPCs = m_model.numBlendDrawCommands != 0 ? m_oitBuffer.devicePtr : VkDeviceAddress{};
-		vkCmdPushConstants(frameData.cmdBuffer, m_postprocessingPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(VkDeviceAddress), &postprocessingPCs);
-		
-		vkCmdPushDescriptorSet(frameData.cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_postprocessingPipelineLayout, 0, 1, ptr(VkWriteDescriptorSet{
-			.descriptorCount = 2,
-			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-			.pImageInfo = ptr({
-				VkDescriptorImageInfo{
-					.imageView = m_colorTarget.view,
-					.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+			}),
+			.commandBufferInfoCount = 1,
+			.pCommandBufferInfos = ptr(VkCommandBufferSubmitInfo{ .commandBuffer = frameData.computeCmdBuffer }),
+			.signalSemaphoreInfoCount = 2,
+			.pSignalSemaphoreInfos = ptr({
+				VkSemaphoreSubmitInfo{
+					.semaphore = frameData.presentSem,
+					.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT
 				},
-				VkDescriptorImageInfo{
-					.imageView = m_swapchainImageViews[imageIndex],
-					.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+				VkSemaphoreSubmitInfo{
+					.semaphore = m_postTimeline,
+					.value = frameNumber,
+					.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT
 				}
 			})
-		}));
-		
-		vkCmdDispatch(frameData.cmdBuffer, (m_width + 7) / 8, (m_height + 7) / 8, 1);
-		
-		vkCmdPipelineBarrier2(frameData.cmdBuffer, ptr(VkDependencyInfo{
-			.imageMemoryBarrierCount = 1,
-			.pImageMemoryBarriers = ptr(VkImageMemoryBarrier2{
-				.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
-				.srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
-				.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
-				.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-				.image = m_swapchainImages[imageIndex],
-				.subresourceRange = colorSubresourceRange()
-			})
-		}));
-
-		vkEndCommandBuffer(frameData.cmdBuffer);
-
-		vkQueueSubmit2(m_graphicsQueue, 1, ptr(VkSubmitInfo2{
-			.waitSemaphoreInfoCount = 1,
-			.pWaitSemaphoreInfos = ptr(VkSemaphoreSubmitInfo{
-				.semaphore = frameData.acquireSem,
-				.stageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
-			}),
-			.commandBufferInfoCount = 1,
-			.pCommandBufferInfos = ptr(VkCommandBufferSubmitInfo{ .commandBuffer = frameData.cmdBuffer }),
-			.signalSemaphoreInfoCount = 1,
-			.pSignalSemaphoreInfos = ptr(VkSemaphoreSubmitInfo{
-				.semaphore = frameData.presentSem,
-				.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT
-			}),
 		}), frameData.fence);
 
 		result = vkQueuePresentKHR(m_graphicsQueue, ptr(VkPresentInfoKHR{
+			.pNext = m_presentWaitSupported ? ptr(VkPresentIdKHR{
+				.swapchainCount = 1,
+				.pPresentIds = ptr(++m_presentId)
+			}) : nullptr,
 			.waitSemaphoreCount = 1,
 			.pWaitSemaphores = &frameData.presentSem,
 			.swapchainCount = 1,
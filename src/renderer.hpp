@@ -7,14 +7,22 @@
 #include <glm/glm.hpp>
 #include <vector>
 #include <filesystem>
+#include <span>
+#ifdef SHADER_HOT_RELOAD
+#include <mutex>
+#include <thread>
+#endif
 #include <limits>
 #include <unordered_map>
+#include <functional>
 #include <fastgltf/types.hpp>
 #include <nfd/nfd.h>
+#include "frame_graph.hpp"
 
 class Renderer {
 	public:
-		Renderer();
+		// importStagingBudget is the host visible memory a model import may stage its uploads through
+		Renderer(u64 importStagingBudget = 64ull << 20);
 		~Renderer();
 	
 		Renderer(const Renderer&) = delete;
@@ -25,9 +33,10 @@ class Renderer {
 	
 		void run();
 		void onResize();
+		void onKey(i32 key, i32 action);
 
 	private:
-		static constexpr u8 m_framesInFlight = 2;
+		static constexpr u8 m_maxFramesInFlight = 3;
 		static constexpr u32 m_irradianceMapSize = 32;
 		static constexpr u32 m_brdfIntegralLUTSize = 1024;
 		static constexpr u32 m_shadowMapSize = 2048; // this is hardcoded in shadow.vert and pbr.glsl
@@ -35,6 +44,9 @@ class Renderer {
 		static constexpr u32 m_poissonDiskFilterSize = 9; // this is hardcoded in pbr.glsl
 		static constexpr VkFormat m_colorFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
 		static constexpr VkFormat m_depthFormat = VK_FORMAT_D32_SFLOAT;
+		static constexpr VkFormat m_visibilityFormat = VK_FORMAT_R32_UINT;
+		static constexpr f32 m_minRenderScale = 0.5f;
+		static constexpr u32 m_timestampsPerFrame = 6; // a start and end for each of the frame's command buffers
 
 		static const inline std::unordered_map<fastgltf::Filter, VkFilter> m_filterMap = {
 			{ fastgltf::Filter::Nearest, VK_FILTER_NEAREST },
@@ -51,6 +63,14 @@ class Renderer {
 			{ fastgltf::Wrap::MirroredRepeat, VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT }
 		};
 
+#ifdef SHADER_HOT_RELOAD
+		using ShaderSource = std::vector<u32>;
+#else
+		using ShaderSource = std::span<const u32>;
+
+		static const std::unordered_map<std::string_view, ShaderSource> m_embeddedShaders;
+#endif
+
 		struct AABB {
 			glm::vec3 min{ std::numeric_limits<f32>::infinity() };
 			glm::vec3 max{ -std::numeric_limits<f32>::infinity() };
@@ -71,6 +91,13 @@ class Renderer {
 			};
 		};
 
+		struct MaterialPermutation {
+			VkPipeline pipeline = {};
+			u32 texBitfield;
+			u64 firstDrawCommand;
+			u64 numDrawCommands = 0;
+		};
+
 		struct Model {
 			std::vector<Image> images;
 			std::vector<VkSampler> samplers;
@@ -79,11 +106,22 @@ class Renderer {
 			Buffer materialBuffer;
 			Buffer vertexBuffer;
 			Buffer indexBuffer;
+			Buffer instanceBuffer;
 			Buffer indirectBuffer;
+			Buffer lightBuffer;
 			glm::mat4 baseTransform;
 			AABB aabb;
+			AABB blendAABB;
+			AABB blendBounds;
 			u64 numOpaqueDrawCommands = 0;
+			u64 numAlphaTestedDrawCommands = 0; // the last of the opaque ones
 			u64 numBlendDrawCommands = 0;
+			u64 numLights = 0;
+			std::vector<MaterialPermutation> opaquePermutations;
+			std::vector<MaterialPermutation> blendPermutations;
+			u32 visibilityDrawBits = 0;
+			VkPipeline visibilityPipeline = {};
+			VkPipeline materialPipeline = {};
 		};
 
 		struct Skybox {
@@ -95,38 +133,103 @@ class Renderer {
 		struct PushConstants {
 			VkDeviceAddress oitBuffer;
 			VkDeviceAddress vertexBuffer;
+			VkDeviceAddress instanceBuffer;
 			VkDeviceAddress materialBuffer;
 			VkDeviceAddress poissonDiskBuffer;
 			glm::mat4 cameraTransform;
 			glm::mat4 lightTransform;
 			glm::mat4x3 modelTransform;
-			glm::vec4 lightColor;
+			VkDeviceAddress clusterBuffer;
 			glm::vec3 camPos;
 			glm::vec3 lightAngle;
-			u32 frameBufferWidth;
+		};
+
+		// PushConstants' layout with the opaque draw commands where the OIT buffer would be, which the material pass never touches, and the index buffer after
+		// pbr.glsl shares the block between both, and the extra address would take the material pass past 256 bytes otherwise
+		struct MaterialPassConstants {
+			VkDeviceAddress drawCommandBuffer;
+			VkDeviceAddress vertexBuffer;
+			VkDeviceAddress instanceBuffer;
+			VkDeviceAddress materialBuffer;
+			VkDeviceAddress poissonDiskBuffer;
+			glm::mat4 cameraTransform;
+			glm::mat4 lightTransform;
+			glm::mat4x3 modelTransform;
+			VkDeviceAddress clusterBuffer;
+			glm::vec3 camPos;
+			glm::vec3 lightAngle;
+			VkDeviceAddress indexBuffer;
+		};
+
+		struct ClusterPushConstants {
+			VkDeviceAddress clusterBuffer;
+			VkDeviceAddress lightBuffer;
+			glm::mat4 viewModelTransform;
+			glm::vec4 sunColor;
+			glm::vec2 projectionScale;
+			u32 numLights;
+			u32 screenWidth;
+			u32 screenHeight;
+		};
+
+		struct PostprocessPushConstants {
+			glm::mat4 reprojection;
+			glm::mat4 skyReprojection;
+			glm::vec2 jitter;
+			f32 historyWeight;
+			u32 renderWidth;
+			u32 renderHeight;
+		};
+
+		struct BloomPushConstants {
+			VkDeviceAddress exposureBuffer;
+			f32 deltaTime;
+		};
+
+		struct PipelineRecipe {
+			VkPipeline* pipeline;
+			std::function<VkPipeline()> create;
 		};
 
 		struct {
 			VkCommandPool cmdPool;
+			VkCommandBuffer prepassCmdBuffer; // lights, shadows and depth, none of which the previous frame's post chain is still reading
 			VkCommandBuffer cmdBuffer;
+			VkCommandPool computeCmdPool;
+			VkCommandBuffer computeCmdBuffer; // OIT resolve and the post chain, on the async compute queue
 			VkSemaphore acquireSem;
 			VkSemaphore presentSem;
 			VkFence fence;
-		} m_perFrameData[m_framesInFlight];
+			b8 timestampsWritten = false;
+		} m_perFrameData[m_maxFramesInFlight];
 
 
 		i32 m_width;
 		i32 m_height;
+		i32 m_renderWidth;
+		i32 m_renderHeight;
+		f32 m_renderScale = 1.0f;
+		b8 m_dynamicResolution = false;
+		f32 m_gpuTimeBudget; // seconds
 		GLFWwindow* m_window;
 		nfdwindowhandle_t m_nativeHandle;
 
 		u8 m_frameIndex = 0;
+		u64 m_frameNumber = 1; // the timelines start at 1, so the first frame can wait on the two "before" it
+		u8 m_framesInFlight = 2;
 		b8 m_swapchainDirty = false;
+		b8 m_latencyLimiter = false;
+		b8 m_oitDirty = false;
+		u64 m_importStagingBudget; // host visible memory createModel stages its uploads through, split between two chunks
 
 		VkInstance m_instance = {};
 		VkPhysicalDevice m_physicalDevice = {};
 		VkPhysicalDeviceMemoryProperties m_memProps;
+		u32 m_directUploadMemoryType = ~0u; // device local, host visible and coherent, ~0u if the device has no such memory
+		b8 m_memoryBudgetSupported = false;
 		u32 m_maxSampledImageDescriptors;
+		b8 m_gpuTimingSupported = false;
+		f32 m_timestampPeriod;
 		VkDevice m_device;
 
 		u32 m_graphicsQueueFamily;
@@ -138,6 +241,10 @@ class Renderer {
 
 		VkSurfaceKHR m_surface = {};
 		VkSurfaceFormatKHR m_surfaceFormat;
+		VkPresentModeKHR m_presentMode = VK_PRESENT_MODE_FIFO_KHR;
+		std::vector<VkPresentModeKHR> m_presentModes;
+		b8 m_presentWaitSupported = false;
+		u64 m_presentId = 0;
 		VkSwapchainKHR m_swapchain = {};
 		std::vector<VkImage> m_swapchainImages;
 		std::vector<VkImageView> m_swapchainImageViews;
@@ -147,13 +254,18 @@ class Renderer {
 		VkPipelineLayout m_modelPipelineLayout = {};
 		VkPipeline m_prepassPipeline = {};
 		VkPipeline m_shadowPipeline = {};
-		VkPipeline m_opaquePipeline = {};
-		VkPipeline m_blendPipeline = {};
+		VkPipeline m_alphaTestPrepassPipeline = {};
+		VkPipeline m_alphaTestShadowPipeline = {};
+
+		VkDescriptorSetLayout m_materialPushDescriptorLayout = {};
+		VkPipelineLayout m_materialPipelineLayout = {};
 
 		VkDescriptorSetLayout m_skyboxSetLayout = {};
 		VkPipelineLayout m_skyboxPipelineLayout = {};
 		VkPipeline m_skyboxPipeline = {};
 		
+		VkQueryPool m_timestampPool = {};
+
 		VkCommandPool m_transferPool = {};
 		VkCommandBuffer m_transferCmd = {};
 
@@ -162,6 +274,9 @@ class Renderer {
 
 		VkSemaphore m_transferToComputeSem = {};
 
+		VkSemaphore m_sceneTimeline = {}; // frame number whose scene the graphics queue has finished
+		VkSemaphore m_postTimeline = {}; // frame number whose post chain the compute queue has finished
+
 		VkDescriptorSetLayout m_oneImageSetLayout = {};
 		VkPipelineLayout m_oneImagePipelineLayout = {};
 
@@ -171,8 +286,20 @@ class Renderer {
 		VkDescriptorSetLayout m_oneTexOneImageSetLayout = {};
 		VkPipelineLayout m_oneTexOneImagePipelineLayout = {};
 		
+		VkDescriptorSetLayout m_oitResolveSetLayout = {};
+		VkPipelineLayout m_oitResolvePipelineLayout = {};
+
+		VkDescriptorSetLayout m_postprocessingSetLayout = {};
 		VkPipelineLayout m_postprocessingPipelineLayout = {};
 
+		VkDescriptorSetLayout m_bloomSetLayout = {};
+		VkPipelineLayout m_bloomPipelineLayout = {};
+
+		VkDescriptorSetLayout m_tonemapSetLayout = {};
+		VkPipelineLayout m_tonemapPipelineLayout = {};
+
+		VkPipelineLayout m_clusterPipelineLayout = {};
+
 		VkPipeline m_mipPipeline = {};
 		VkPipeline m_srgbMipPipeline = {};
 		VkPipeline m_cubePipeline = {};
@@ -180,12 +307,52 @@ class Renderer {
 		VkPipeline m_irradiancePipeline = {};
 		VkPipeline m_radiancePipeline = {};
 		VkPipeline m_brdfIntegralPipeline = {};
+		VkPipeline m_oitResolvePipeline = {};
 		VkPipeline m_postprocessingPipeline = {};
+		VkPipeline m_bloomDownPipeline = {};
+		VkPipeline m_bloomUpPipeline = {};
+		VkPipeline m_tonemapPipeline = {};
+		VkPipeline m_clusterPipeline = {};
+
+		std::vector<PipelineRecipe> m_pipelineRecipes;
+
+#ifdef SHADER_HOT_RELOAD
+		std::mutex m_hotReloadMutex;
+		std::mutex m_pipelineRecipesMutex; // held by watchShaders while it runs recipes, whose callbacks point into m_model
+		std::unordered_map<VkPipeline, std::vector<std::filesystem::path>> m_pipelineShaders;
+		std::vector<std::pair<VkPipeline*, VkPipeline>> m_reloadedPipelines;
+		std::jthread m_shaderWatcher;
+#endif
 
 		Buffer m_poissonDiskBuffer;
+		Buffer m_clusterBuffer;
 		Buffer m_oitBuffer;
+		u64 m_oitBufferPixels = 0;
+		u64 m_oitTileMaskOffset = 0;
+		u64 m_oitTileMaskSize = 0;
+		u32 m_oitNodeCount = 4;
+		b8 m_fragmentShaderInterlockSupported = false;
+		b8 m_weightedBlendedOIT = false;
+		Image m_oitAccumTarget;
+		Image m_oitRevealageTarget;
+		b8 m_visibilityBufferSupported = false;
+		b8 m_visibilityBuffer = false;
+		Image m_visibilityTarget;
+		b8 m_temporalAA = true;
+		b8 m_historyValid = false;
+		u8 m_historyIndex = 0;
+		u32 m_temporalFrame = 0;
+		Image m_historyTargets[2]; // swapchain sized, postprocess.comp reads one and writes the other
+		glm::mat4 m_previousCameraTransform{ 1.0f };
+		glm::mat4 m_previousModelTransform{ 1.0f };
+		Image m_bloomTarget; // half swapchain size, one storage view per mip
+		std::vector<VkImageView> m_bloomMipViews;
+		u32 m_bloomMipCount = 0;
+		Buffer m_exposureBuffer;
+		f64 m_previousFrameTime = 0.0;
 		Image m_colorTarget;
-		Image m_depthTarget;
+		Image m_depthTargets[2]; // alternating, so a frame's prepass doesn't wait on the previous frame's post chain sampling it
+		FrameGraph m_frameGraph; // barriers for the frame being recorded, and what each resource was left in by the previous one
 		Model m_model;
 
 		Skybox m_skybox;
@@ -193,6 +360,7 @@ class Renderer {
 		Image m_shadowMap;
 		VkSampler m_skyboxSampler = {};
 		VkSampler m_shadowSampler = {};
+		VkSampler m_postprocessingSampler = {};
 
 		f32 m_fov = 90.0f;
 		glm::vec3 m_position{ 0.0f, 0.0f, -2.0f };
@@ -200,7 +368,13 @@ class Renderer {
 
 		u32 getQueue(VkQueueFlags include, VkQueueFlags exclude = 0);
 		u32 getMemoryIndex(VkMemoryPropertyFlags flags, u32 mask);
-		std::vector<u32> getShaderSource(std::filesystem::path);
+		u64 getDirectUploadBudget();
+		ShaderSource getShaderSource(std::filesystem::path path);
+#ifdef SHADER_HOT_RELOAD
+		void watchShaders(std::stop_token stop);
+		void swapReloadedPipelines();
+		void discardReloadedPipeline(VkPipeline pipeline);
+#endif
 		void createSwapchain();
 		void recreateSwapchain();
 
@@ -208,16 +382,25 @@ class Renderer {
 		void destroyImage(Image image);
 
 		Buffer createBuffer(u64 size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memProps);
+		Buffer createUploadBuffer(VkBufferUsageFlags usage, std::initializer_list<std::span<const std::byte>> data, std::vector<Buffer>& stagingBuffers);
 		void destroyBuffer(Buffer buffer);
 
+		void createOITResources(u64 numPixels);
+		void destroyOITResources();
+		void rebuildOITPipelines();
+		VkRect2D getScreenRect(const glm::mat4& transform, const AABB& bounds);
+
 		void createModel(std::filesystem::path path);
 		void destroyModel(Model model);
 
 		void createSkybox(std::filesystem::path path);
 		void destroySkybox(Skybox skybox);
 
-		VkPipeline createComputePipeline(VkPipelineLayout layout, std::filesystem::path shaderPath);
-		VkPipeline createGraphicsPipeline(VkPipelineLayout layout, std::filesystem::path vsPath, std::filesystem::path fsPath, VkCullModeFlagBits cullMode, VkCompareOp compareOp, bool depthWrite, bool hasColorAttachment);
+		VkPipeline createComputePipeline(VkPipelineLayout layout, std::filesystem::path shaderPath, std::span<const u32> specConstants = {});
+		VkPipeline createGraphicsPipeline(VkPipelineLayout layout, std::filesystem::path vsPath, std::filesystem::path fsPath, VkCullModeFlagBits cullMode, VkCompareOp compareOp, bool depthWrite, std::span<const VkFormat> colorFormats, std::span<const VkPipelineColorBlendAttachmentState> blendStates = {}, std::span<const u32> fsSpecConstants = {});
+		VkPipeline createPermutationPipeline(const MaterialPermutation& permutation, b8 blend);
+		VkPipeline createVisibilityPipeline(u32 drawBits, b8 material);
+		void rebuildPipeline(VkPipeline* pipeline);
 };
 
 #endif
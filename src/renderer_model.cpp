@@ -1,48 +1,185 @@
 #include "renderer.hpp"
+#include "vertex_convert.hpp"
 #include "../shared/vertex.h"
 #include "../shared/material.h"
+#include "../shared/instance.h"
+#include "../shared/cluster.h"
 #include <fastgltf/core.hpp>
 #include <fastgltf/glm_element_traits.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <mikktspace/mikktspace.h>
+#include <meshoptimizer/meshoptimizer.h>
 #include <stb/stb_image.h>
+#include <stb/stb_image_output.h>
 #include <ranges>
 #include <execution>
+#include <future>
+#include <atomic>
+#include <bit>
+#include <array>
+#include <cstring>
 #include <tbrs/vk_util.hpp>
 
 void Renderer::createModel(std::filesystem::path path) {
 	const fastgltf::Extensions extensions =
-		fastgltf::Extensions::KHR_materials_emissive_strength;
-
+		fastgltf::Extensions::KHR_materials_emissive_strength |
+		fastgltf::Extensions::KHR_lights_punctual |
+		fastgltf::Extensions::EXT_mesh_gpu_instancing |
+		fastgltf::Extensions::EXT_meshopt_compression |
+		fastgltf::Extensions::KHR_mesh_quantization;
+
+	// the file is memory mapped rather than read in, and so are external buffers and images instead of fastgltf loading them into heap copies
+	// accessors and image decoding then read straight from the page cache, the mappings only have to outlive this function
 	fastgltf::Parser parser{ extensions };
-	fastgltf::GltfDataBuffer data = std::move(fastgltf::GltfDataBuffer::FromPath(path).get());
+	fastgltf::MappedGltfFile file = std::move(fastgltf::MappedGltfFile::FromPath(path).get());
+
+	const fastgltf::Options options = fastgltf::Options::GenerateMeshIndices;
+
+	fastgltf::Asset asset{ std::move(parser.loadGltf(file, path.parent_path(), options).get()) };
+
+	// fastgltf can't be told to leave a .glb's binary chunk where it is, it always parses it into a heap copy
+	// that copy is swapped for a view of the chunk in the mapping right away, so it's gone before the rest of the import runs
+	// the chunk follows the 12 byte header and the JSON chunk, each chunk starting with its length and type
+	const fastgltf::span<std::byte> fileBytes = static_cast<fastgltf::span<std::byte>>(file);
+	auto readU32 = [&fileBytes](u64 offset) {
+		u32 value;
+		std::memcpy(&value, fileBytes.data() + offset, sizeof(u32));
+		return value;
+	};
+	if(fileBytes.size() >= 20 && readU32(0) == 0x46546C67 && !asset.buffers.empty() && std::holds_alternative<fastgltf::sources::Array>(asset.buffers[0].data)) {
+		const u64 binChunk = 20 + readU32(12);
+		if(binChunk + 8 <= fileBytes.size() && readU32(binChunk + 4) == 0x004E4942 && binChunk + 8 + readU32(binChunk) <= fileBytes.size()) {
+			asset.buffers[0].data = fastgltf::sources::ByteView{ fastgltf::span<const std::byte>(fileBytes.data() + binChunk + 8, readU32(binChunk)) };
+		}
+	}
+
+	std::vector<fastgltf::MappedGltfFile> externalFiles;
+	auto mapExternal = [&](fastgltf::DataSource& source) {
+		if(const fastgltf::sources::URI* uri = std::get_if<fastgltf::sources::URI>(&source)) {
+			fastgltf::MappedGltfFile& mapped = externalFiles.emplace_back(std::move(fastgltf::MappedGltfFile::FromPath(path.parent_path() / uri->uri.fspath()).get()));
+			const fastgltf::span<std::byte> bytes = static_cast<fastgltf::span<std::byte>>(mapped).subspan(uri->fileByteOffset);
+			source = fastgltf::sources::ByteView{ fastgltf::span<const std::byte>(bytes.data(), bytes.size()), uri->mimeType };
+		}
+	};
+	for(fastgltf::Buffer& buffer : asset.buffers) {
+		mapExternal(buffer.data);
+	}
+	for(fastgltf::Image& image : asset.images) {
+		mapExternal(image.data);
+	}
+
+	// compressed views are decoded into one heap block up front, a worker thread each, and then read like any other view
+	// the vertex codec and filters are vectorized themselves, threads on top of that keep large assets from decoding on one core
+	std::vector<std::byte> meshoptDecoded;
+	std::vector<fastgltf::BufferView*> compressedViews;
+	std::vector<u64> decodedOffsets;
+	for(fastgltf::BufferView& view : asset.bufferViews) {
+		if(view.meshoptCompression) {
+			compressedViews.push_back(&view);
+			decodedOffsets.push_back(meshoptDecoded.size());
+			meshoptDecoded.resize(meshoptDecoded.size() + ((view.meshoptCompression->count * view.meshoptCompression->byteStride + 15) & ~15ull));
+		}
+	}
+
+	if(!compressedViews.empty()) {
+		std::atomic<b8> decodeFailed = false;
+		std::for_each(std::execution::par, compressedViews.begin(), compressedViews.end(), [&](fastgltf::BufferView* const& view) {
+			const fastgltf::CompressedBufferView& meshopt = *view->meshoptCompression;
+			const fastgltf::span<const std::byte> buffer = std::visit(fastgltf::visitor{
+				[](const auto&) { return fastgltf::span<const std::byte>(); },
+				[](const fastgltf::sources::Array& array) { return fastgltf::span<const std::byte>(array.bytes.data(), array.bytes.size()); },
+				[](const fastgltf::sources::ByteView& byteView) { return byteView.bytes; }
+			}, asset.buffers[meshopt.bufferIndex].data);
+			// the decoders and filters only assert on strides and counts the extension doesn't allow, so those are failed here like a bad stream
+			const b8 validStride = (meshopt.mode != fastgltf::MeshoptCompressionMode::Triangles || meshopt.count % 3 == 0) && (meshopt.mode == fastgltf::MeshoptCompressionMode::Attributes ? meshopt.byteStride % 4 == 0 && meshopt.byteStride <= 256 : meshopt.byteStride == 2 || meshopt.byteStride == 4);
+			// filters only apply to attributes, the exponential one to any of their strides, octahedral to 4 or 8 bytes and quaternion to 8
+			const b8 validFilter = meshopt.filter == fastgltf::MeshoptCompressionFilter::None || (meshopt.mode == fastgltf::MeshoptCompressionMode::Attributes &&
+				(meshopt.filter == fastgltf::MeshoptCompressionFilter::Exponential || meshopt.byteStride == 8 || (meshopt.byteStride == 4 && meshopt.filter == fastgltf::MeshoptCompressionFilter::Octahedral)));
+			if(!validStride || !validFilter || meshopt.byteStride == 0 || meshopt.byteOffset + meshopt.byteLength > buffer.size()) {
+				decodeFailed = true;
+				return;
+			}
+			const unsigned char* src = reinterpret_cast<const unsigned char*>(buffer.data()) + meshopt.byteOffset;
+			void* dst = meshoptDecoded.data() + decodedOffsets[&view - compressedViews.data()];
+
+			i32 result = 0;
+			switch(meshopt.mode) {
+				case fastgltf::MeshoptCompressionMode::Attributes:
+					result = meshopt_decodeVertexBuffer(dst, meshopt.count, meshopt.byteStride, src, meshopt.byteLength);
+					break;
+				case fastgltf::MeshoptCompressionMode::Triangles:
+					result = meshopt_decodeIndexBuffer(dst, meshopt.count, meshopt.byteStride, src, meshopt.byteLength);
+					break;
+				case fastgltf::MeshoptCompressionMode::Indices:
+					result = meshopt_decodeIndexSequence(dst, meshopt.count, meshopt.byteStride, src, meshopt.byteLength);
+					break;
+			}
+			if(result != 0) {
+				decodeFailed = true;
+				return;
+			}
 
-	const fastgltf::Options options =
-		fastgltf::Options::GenerateMeshIndices |
-		fastgltf::Options::LoadExternalBuffers |
-		fastgltf::Options::LoadExternalImages;
+			switch(meshopt.filter) {
+				case fastgltf::MeshoptCompressionFilter::None:
+					break;
+				case fastgltf::MeshoptCompressionFilter::Octahedral:
+					meshopt_decodeFilterOct(dst, meshopt.count, meshopt.byteStride);
+					break;
+				case fastgltf::MeshoptCompressionFilter::Quaternion:
+					meshopt_decodeFilterQuat(dst, meshopt.count, meshopt.byteStride);
+					break;
+				case fastgltf::MeshoptCompressionFilter::Exponential:
+					meshopt_decodeFilterExp(dst, meshopt.count, meshopt.byteStride);
+					break;
+			}
+		});
+
+		// a truncated or corrupt view would leave its accessors reading garbage, so the import is dropped before anything is created and the current model stays
+		if(decodeFailed) {
+			return;
+		}
+
+		// the views' own buffer is usually a fallback without any data, they're pointed at the decoded block instead
+		asset.buffers.push_back(fastgltf::Buffer{
+			.byteLength = meshoptDecoded.size(),
+			.data = fastgltf::sources::ByteView{ fastgltf::span<const std::byte>(meshoptDecoded.data(), meshoptDecoded.size()) }
+		});
+		for(const auto& [idx, view] : std::views::enumerate(compressedViews)) {
+			view->bufferIndex = asset.buffers.size() - 1;
+			view->byteOffset = decodedOffsets[idx];
+			view->meshoptCompression.reset();
+		}
+	}
 
-	const fastgltf::Asset asset{ std::move(parser.loadGltf(data, path.parent_path(), options).get()) };
+	// external images are mapped now, embedded ones point into a (mapped) buffer, and data URIs were decoded by fastgltf
+	auto getImageBytes = [&asset](const fastgltf::Image& image) -> fastgltf::span<const std::byte> {
+		if(const fastgltf::sources::BufferView* view = std::get_if<fastgltf::sources::BufferView>(&image.data)) {
+			return fastgltf::DefaultBufferDataAdapter{}(asset, view->bufferViewIndex);
+		}
+		if(const fastgltf::sources::Array* array = std::get_if<fastgltf::sources::Array>(&image.data)) {
+			return fastgltf::span<const std::byte>(array->bytes.data(), array->bytes.size());
+		}
+		return std::get<fastgltf::sources::ByteView>(image.data).bytes;
+	};
 
 	std::unordered_map<u32, b8> isSrgb;
 	std::vector<VkImageView> mipViews;
-	std::vector<Buffer> imageStagingBuffers;
+	std::vector<Buffer> stagingBuffers;
 	std::vector<Image> images;
 	std::vector<VkSampler> samplers;
 	std::vector<Material> materials;
-	std::vector<Vertex> vertices;
-	std::vector<u32> indices;
 	std::vector<VkDrawIndexedIndirectCommand> opaqueDrawCmds;
 	std::vector<VkDrawIndexedIndirectCommand> blendDrawCmds;
+	std::vector<Light> lights;
 	std::vector<VkDescriptorImageInfo> descriptors;
 	VkDescriptorPool pool = {};
 	VkDescriptorSet set = {};
 
 	AABB aabb;
+	AABB blendAABB;
 
 	vkBeginCommandBuffer(m_transferCmd, ptr(VkCommandBufferBeginInfo{ .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT }));
-	vkBeginCommandBuffer(m_computeCmd, ptr(VkCommandBufferBeginInfo{ .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT }));
 
 	for(const fastgltf::Material& mat : asset.materials) {
 		Material m = {
@@ -79,34 +216,172 @@ void Renderer::createModel(std::filesystem::path path) {
 			m.texBitfield |= HAS_EMISSIVE;
 		}
 
+		if(mat.alphaMode == fastgltf::AlphaMode::Mask) {
+			m.alphaCutoff = mat.alphaCutoff;
+			m.texBitfield |= ALPHA_MASK;
+		}
+
 		materials.push_back(m);
 	}
 
-	const u64 materialBufferByteSize = materials.size() * sizeof(Material);
-	Buffer stagingMaterialBuffer = createBuffer(materialBufferByteSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	Buffer materialBuffer = createBuffer(materialBufferByteSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	
-	memcpy(stagingMaterialBuffer.hostPtr, materials.data(), materialBufferByteSize);
+	Buffer materialBuffer = createUploadBuffer(VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, { std::as_bytes(std::span(materials)) }, stagingBuffers);
+
+	// uploads are staged through m_importStagingBudget bytes of host memory, split into chunks that are flushed to the transfer queue as they fill
+	// a chunk is reused once its fence says its copies are done, so the upload never holds more than the budget, however big the asset is
+	// the exception is an image bigger than a chunk, which gets staging of its own and is flushed with its chunk straight away, so at most one of those is held per chunk
+	// each chunk also carries the mip generation for the images copied by it, submitted to the compute queue right behind its copies
+	// so mips for one chunk are built while the next is still being decoded and filled, rather than all at the end of the import
+	struct ImageDecode {
+		stbi_uc* staging;
+		u64 byteSize;
+		fastgltf::span<const std::byte> bytes;
+	};
+
+	struct StagingChunk {
+		Buffer buffer;
+		VkCommandBuffer cmd;
+		VkCommandBuffer mipCmd;
+		VkSemaphore copiedSem;
+		VkFence fence; // signaled by the mip submission, which waits on the copies
+		u64 used;
+		std::vector<Buffer> oversized; // staging of their own for images that don't fit in a chunk, freed along with it
+		std::vector<ImageDecode> decodes; // images to decode into the chunk, run in parallel just before it's submitted
+	};
+
+	VkCommandPool chunkPool;
+	vkCreateCommandPool(m_device, ptr(VkCommandPoolCreateInfo{
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		.queueFamilyIndex = m_transferQueueFamily
+	}), nullptr, &chunkPool);
+
+	VkCommandPool mipPool;
+	vkCreateCommandPool(m_device, ptr(VkCommandPoolCreateInfo{
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		.queueFamilyIndex = m_computeQueueFamily
+	}), nullptr, &mipPool);
+
+	// two, so one is filled while the other's copies run
+	std::array<StagingChunk, 2> chunks;
+	const u64 chunkSize = m_importStagingBudget / chunks.size();
+	for(StagingChunk& chunk : chunks) {
+		chunk.buffer = createBuffer(chunkSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		vkAllocateCommandBuffers(m_device, ptr(VkCommandBufferAllocateInfo{
+			.commandPool = chunkPool,
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1
+		}), &chunk.cmd);
+		vkAllocateCommandBuffers(m_device, ptr(VkCommandBufferAllocateInfo{
+			.commandPool = mipPool,
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1
+		}), &chunk.mipCmd);
+		vkCreateSemaphore(m_device, ptr(VkSemaphoreCreateInfo{}), nullptr, &chunk.copiedSem);
+		vkCreateFence(m_device, ptr(VkFenceCreateInfo{ .flags = VK_FENCE_CREATE_SIGNALED_BIT }), nullptr, &chunk.fence);
+		chunk.used = 0;
+	}
+	u32 currentChunk = 0;
+
+	auto beginChunk = [&] {
+		StagingChunk& chunk = chunks[currentChunk];
+		vkWaitForFences(m_device, 1, &chunk.fence, true, UINT64_MAX);
+		vkResetFences(m_device, 1, &chunk.fence);
+		for(Buffer i : chunk.oversized) {
+			destroyBuffer(i);
+		}
+		chunk.oversized.clear();
+		chunk.used = 0;
+
+		vkResetCommandBuffer(chunk.cmd, 0);
+		vkBeginCommandBuffer(chunk.cmd, ptr(VkCommandBufferBeginInfo{ .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT }));
+		vkResetCommandBuffer(chunk.mipCmd, 0);
+		vkBeginCommandBuffer(chunk.mipCmd, ptr(VkCommandBufferBeginInfo{ .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT }));
+	};
+
+	auto submitChunk = [&] {
+		StagingChunk& chunk = chunks[currentChunk];
+		// the output buffer is per thread, so it's set on whichever worker picks the image up
+		std::for_each(std::execution::par, chunk.decodes.begin(), chunk.decodes.end(), [](const ImageDecode& decode) {
+			i32 width, height;
+			stbi_set_output_buffer(decode.staging, decode.byteSize);
+			stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(decode.bytes.data()), decode.bytes.size(), &width, &height, nullptr, STBI_rgb_alpha);
+			if(pixels != decode.staging) {
+				memcpy(decode.staging, pixels, decode.byteSize);
+			}
+			stbi_image_free(pixels);
+			stbi_set_output_buffer(nullptr, 0);
+		});
+		chunk.decodes.clear();
+
+		vkEndCommandBuffer(chunk.cmd);
+		vkQueueSubmit2(m_transferQueue, 1, ptr(VkSubmitInfo2{
+			.commandBufferInfoCount = 1,
+			.pCommandBufferInfos = ptr(VkCommandBufferSubmitInfo{.commandBuffer = chunk.cmd }),
+			.signalSemaphoreInfoCount = 1,
+			.pSignalSemaphoreInfos = ptr(VkSemaphoreSubmitInfo{
+				.semaphore = chunk.copiedSem,
+				.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT
+			})
+		}), nullptr);
+
+		vkEndCommandBuffer(chunk.mipCmd);
+		vkQueueSubmit2(m_computeQueue, 1, ptr(VkSubmitInfo2{
+			.waitSemaphoreInfoCount = 1,
+			.pWaitSemaphoreInfos = ptr(VkSemaphoreSubmitInfo{
+				.semaphore = chunk.copiedSem,
+				.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT
+			}),
+			.commandBufferInfoCount = 1,
+			.pCommandBufferInfos = ptr(VkCommandBufferSubmitInfo{.commandBuffer = chunk.mipCmd })
+		}), chunk.fence);
+		currentChunk = (currentChunk + 1) % chunks.size();
+	};
+
+	// the chunk to stage size bytes (at most a chunk's worth) in, moving on to the next one if they don't fit in the current one
+	auto reserveStaging = [&](u64 size) -> StagingChunk& {
+		if(chunks[currentChunk].used + size > chunkSize) {
+			submitChunk();
+			beginChunk();
+		}
+		return chunks[currentChunk];
+	};
 
-	vkCmdCopyBuffer(m_transferCmd, stagingMaterialBuffer.buffer, materialBuffer.buffer, 1, ptr(VkBufferCopy{ .size = materialBufferByteSize }));
+	beginChunk();
 
+	// the headers give every image's size up front, so each can be decoded straight into its place in a chunk instead of going through a heap copy
+	std::vector<glm::ivec2> imageSizes(asset.images.size());
 	for(const auto& [idx, img] : std::views::enumerate(asset.images)) {
-		i32 width;
-		i32 height;
-		const fastgltf::sources::Array& data = std::get<fastgltf::sources::Array>(img.data);
-		stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(data.bytes.data()), data.bytes.size(), &width, &height, nullptr, STBI_rgb_alpha);
+		const fastgltf::span<const std::byte> bytes = getImageBytes(img);
+		stbi_info_from_memory(reinterpret_cast<const stbi_uc*>(bytes.data()), bytes.size(), &imageSizes[idx].x, &imageSizes[idx].y, nullptr);
+	}
 
-		u8 numMips = std::floor(std::log2(std::max(width, height))) + 1;
+	for(const auto& [idx, img] : std::views::enumerate(asset.images)) {
+		i32 width = imageSizes[idx].x;
+		i32 height = imageSizes[idx].y;
+		const u64 byteSize = static_cast<u64>(width) * height * 4;
+
+		StagingChunk& chunk = reserveStaging(byteSize > chunkSize ? 0 : byteSize);
+		Buffer stagingBuffer = chunk.buffer;
+		u64 stagingOffset = chunk.used;
+		if(byteSize > chunkSize) {
+			stagingBuffer = createBuffer(byteSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			stagingOffset = 0;
+			chunk.oversized.push_back(stagingBuffer);
+		}
+		else {
+			chunk.used = (chunk.used + byteSize + 15) & ~15ull;
+		}
+		stbi_uc* staging = reinterpret_cast<stbi_uc*>(stagingBuffer.hostPtr) + stagingOffset;
 
-		Buffer stagingBuffer = createBuffer(width * height * 4, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		imageStagingBuffers.push_back(stagingBuffer);
-		memcpy(stagingBuffer.hostPtr, pixels, width * height * 4);
-		stbi_image_free(pixels);
+		// the copy and mips only need the size, so they're recorded here and the decode is deferred until the chunk is full
+		// the chunk's images are then decoded together on the parallel algorithms' pool, so the threads in flight are bounded by it and the memory by the chunk
+		chunk.decodes.push_back({ staging, byteSize, getImageBytes(img) });
+
+		u8 numMips = std::floor(std::log2(std::max(width, height))) + 1;
 
 		Image image = createImage(width, height, isSrgb[idx] ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, numMips);
 		images.push_back(image);
 
-		vkCmdPipelineBarrier2(m_transferCmd, ptr(VkDependencyInfo{
+		vkCmdPipelineBarrier2(chunk.cmd, ptr(VkDependencyInfo{
 			.imageMemoryBarrierCount = 1,
 			.pImageMemoryBarriers = ptr(VkImageMemoryBarrier2{
 				.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
@@ -117,18 +392,19 @@ void Renderer::createModel(std::filesystem::path path) {
 			})
 		}));
 
-		vkCmdCopyBufferToImage2(m_transferCmd, ptr(VkCopyBufferToImageInfo2{
+		vkCmdCopyBufferToImage2(chunk.cmd, ptr(VkCopyBufferToImageInfo2{
 			.srcBuffer = stagingBuffer.buffer,
 			.dstImage = image.image,
 			.dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			.regionCount = 1,
 			.pRegions = ptr(VkBufferImageCopy2{
+				.bufferOffset = stagingOffset,
 				.imageSubresource = VkImageSubresourceLayers{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
 				.imageExtent = { static_cast<u32>(width), static_cast<u32>(height), 1 }
 			})
 		}));
 
-		vkCmdPipelineBarrier2(m_transferCmd, ptr(VkDependencyInfo{
+		vkCmdPipelineBarrier2(chunk.cmd, ptr(VkDependencyInfo{
 			.imageMemoryBarrierCount = 1,
 			.pImageMemoryBarriers = ptr(VkImageMemoryBarrier2{
 				.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
@@ -149,7 +425,7 @@ void Renderer::createModel(std::filesystem::path path) {
 		}), nullptr, &mip0View);
 		mipViews.push_back(mip0View);
 
-		vkCmdBindPipeline(m_computeCmd, VK_PIPELINE_BIND_POINT_COMPUTE, isSrgb[idx] ? m_srgbMipPipeline: m_mipPipeline);
+		vkCmdBindPipeline(chunk.mipCmd, VK_PIPELINE_BIND_POINT_COMPUTE, isSrgb[idx] ? m_srgbMipPipeline: m_mipPipeline);
 		for(u8 i = 1; i < numMips; i++) {
 			VkImageView curMipView;
 			vkCreateImageView(m_device, ptr(VkImageViewCreateInfo{
@@ -159,7 +435,7 @@ void Renderer::createModel(std::filesystem::path path) {
 				.subresourceRange = VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 }
 			}), nullptr, &curMipView);
 
-			vkCmdPushDescriptorSet(m_computeCmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_twoImagePipelineLayout, 0, 1, ptr(VkWriteDescriptorSet{
+			vkCmdPushDescriptorSet(chunk.mipCmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_twoImagePipelineLayout, 0, 1, ptr(VkWriteDescriptorSet{
 				.descriptorCount = 2,
 				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
 				.pImageInfo = ptr({
@@ -175,9 +451,9 @@ void Renderer::createModel(std::filesystem::path path) {
 			}));
 			mipViews.push_back(curMipView);
 
-			vkCmdDispatch(m_computeCmd, (std::max(width >> i, 1) + 7) / 8, (std::max(height >> i, 1) + 7) / 8, 1);
+			vkCmdDispatch(chunk.mipCmd, (std::max(width >> i, 1) + 7) / 8, (std::max(height >> i, 1) + 7) / 8, 1);
 
-			vkCmdPipelineBarrier2(m_computeCmd, ptr(VkDependencyInfo{
+			vkCmdPipelineBarrier2(chunk.mipCmd, ptr(VkDependencyInfo{
 				.imageMemoryBarrierCount = 1,
 				.pImageMemoryBarriers = ptr(VkImageMemoryBarrier2{
 					.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
@@ -190,7 +466,7 @@ void Renderer::createModel(std::filesystem::path path) {
 			}));
 		}
 
-		vkCmdPipelineBarrier2(m_computeCmd, ptr(VkDependencyInfo{
+		vkCmdPipelineBarrier2(chunk.mipCmd, ptr(VkDependencyInfo{
 			.imageMemoryBarrierCount = 1,
 			.pImageMemoryBarriers = ptr(VkImageMemoryBarrier2{
 				.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
@@ -201,9 +477,13 @@ void Renderer::createModel(std::filesystem::path path) {
 				.subresourceRange = colorSubresourceRange()
 			})
 		}));
-	}
 
-	vkEndCommandBuffer(m_computeCmd);
+		// its staging is freed by the chunk's fence, which only gets waited on if the chunk is submitted, so the next oversized image can't pile up behind it
+		if(byteSize > chunkSize) {
+			submitChunk();
+			beginChunk();
+		}
+	}
 
 	for(const fastgltf::Sampler& s : asset.samplers) {
 		VkSampler sampler;
@@ -268,20 +548,22 @@ void Renderer::createModel(std::filesystem::path path) {
 		.pImageInfo = descriptors.data()
 	}), 0, nullptr);
 
+	// a serial walk over the node tree places every primitive instance in the vertex and index buffers (each mesh instance gets its own copy of the vertices)
+	// and makes its draw, which leaves the conversion of each instance independent of the others so they can run in parallel
+	struct PrimitiveInstance {
+		const fastgltf::Primitive* primitive;
+		glm::mat4 transform;
+		u64 vertexOffset;
+		u64 indexOffset;
+		u64 numVertices;
+		u64 numIndices;
+		u64 firstInstance; // into instances, which the bounds have to cover too
+		u64 numInstances;
+	};
+	std::vector<PrimitiveInstance> primitiveInstances;
+	std::vector<Instance> instances;
 	u64 numVertices = 0;
 	u64 numIndices = 0;
-	u64 numPrimitives = 0;
-	for(const fastgltf::Mesh curMesh : asset.meshes) {
-		for(u64 i = 0; i < curMesh.primitives.size(); i++) {
-			numVertices += asset.accessors[curMesh.primitives[i].findAttribute("POSITION")->accessorIndex].count;
-			numIndices += asset.accessors[curMesh.primitives[i].indicesAccessor.value()].count;
-			numPrimitives++;
-		}
-	}
-
-	vertices.reserve(numVertices);
-	indices.reserve(numIndices);
-	opaqueDrawCmds.reserve(numPrimitives);
 
 	auto processNode = [&](this auto& self, u64 index, glm::mat4 transform) -> void {
 		const fastgltf::Node& curNode = asset.nodes[index];
@@ -296,86 +578,68 @@ void Renderer::createModel(std::filesystem::path path) {
 			}
 		}, curNode.transform);
 
-		if(curNode.meshIndex.has_value()) {
-			const glm::mat3 normalTransform{ glm::transpose(glm::inverse(transform)) };
-			const fastgltf::Mesh& curMesh = asset.meshes[curNode.meshIndex.value()];
-			for(const fastgltf::Primitive& curPrimitive : curMesh.primitives) {
-				const u64 oldVerticesSize = vertices.size();
-				const u64 oldIndicesSize = indices.size();
-
-				const fastgltf::Accessor& indexAccessor = asset.accessors[curPrimitive.indicesAccessor.value()];
-				fastgltf::iterateAccessor<u32>(asset, indexAccessor, [&indices](u32 index) {
-					indices.emplace_back(index);
-				});
-
-				const fastgltf::Accessor& positionAccessor = asset.accessors[curPrimitive.findAttribute("POSITION")->accessorIndex];
-				fastgltf::iterateAccessor<glm::vec3>(asset, positionAccessor, [&vertices, &aabb, transform](glm::vec3 pos) {
-					glm::vec3 vertex = glm::vec3(transform * glm::vec4(pos, 1.0f));
-					aabb.min = glm::min(aabb.min, vertex);
-					aabb.max = glm::max(aabb.max, vertex);
-					vertices.emplace_back(vertex);
-				});
-
-				const fastgltf::Accessor& normalAccessor = asset.accessors[curPrimitive.findAttribute("NORMAL")->accessorIndex];
-				fastgltf::iterateAccessorWithIndex<glm::vec3>(asset, normalAccessor, [&vertices, oldVerticesSize, normalTransform](glm::vec3 normal, u64 index) {
-					vertices[index + oldVerticesSize].normal = glm::normalize(normalTransform * normal);
-				});
+		if(curNode.lightIndex.has_value()) {
+			const fastgltf::Light& curLight = asset.lights[curNode.lightIndex.value()];
+			const glm::vec3 color = glm::make_vec3(curLight.color.data()) * static_cast<f32>(curLight.intensity);
+
+			// lights without a range are culled where they fall below one 8 bit step at unit exposure
+			const f32 range = curLight.range.has_value() ? static_cast<f32>(curLight.range.value()) : std::sqrt(std::max(color.r, std::max(color.g, color.b)) * 256.0f);
+
+			// KHR_lights_punctual's cone falloff as a scale and offset on the cosine to the spot direction
+			const f32 cosInner = std::cos(static_cast<f32>(curLight.innerConeAngle.value_or(0.0f)));
+			const f32 cosOuter = std::cos(static_cast<f32>(curLight.outerConeAngle.value_or(glm::quarter_pi<f32>())));
+			const f32 spotScale = 1.0f / std::max(cosInner - cosOuter, 0.001f);
+
+			lights.push_back(Light{
+				.position = glm::vec3(transform * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)),
+				.range = range,
+				.direction = glm::normalize(glm::vec3(transform * glm::vec4(0.0f, 0.0f, -1.0f, 0.0f))),
+				.spotScale = spotScale,
+				.color = color,
+				.spotOffset = -cosOuter * spotScale,
+				.type = curLight.type == fastgltf::LightType::Spot ? LIGHT_TYPE_SPOT : curLight.type == fastgltf::LightType::Directional ? LIGHT_TYPE_DIRECTIONAL : LIGHT_TYPE_POINT
+			});
+		}
 
-				const fastgltf::Attribute* uvAccessorIndex;
-				if((uvAccessorIndex = curPrimitive.findAttribute("TEXCOORD_0")) != curPrimitive.attributes.cend()) {
-					const fastgltf::Accessor& uvAccessor = asset.accessors[uvAccessorIndex->accessorIndex];
-					fastgltf::iterateAccessorWithIndex<glm::vec2>(asset, uvAccessor, [&vertices, oldVerticesSize](glm::vec2 uv, u64 index) {
-						vertices[index + oldVerticesSize].uv = uv;
-					});
+		if(curNode.meshIndex.has_value()) {
+			// EXT_mesh_gpu_instancing nodes keep their vertices in mesh space and get an instance per TRS, each applied before the node's transform
+			// everything else has its node transform baked into its vertices and is drawn as a single identity instance
+			std::vector<glm::mat4x3> instanceTransforms;
+			if(!curNode.instancingAttributes.empty()) {
+				const u64 count = asset.accessors[curNode.instancingAttributes[0].accessorIndex].count;
+				std::vector<glm::vec3> translations(count, glm::vec3(0.0f));
+				std::vector<glm::quat> rotations(count, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+				std::vector<glm::vec3> scales(count, glm::vec3(1.0f));
+
+				if(auto attribute = curNode.findInstancingAttribute("TRANSLATION"); attribute != curNode.instancingAttributes.cend()) {
+					fastgltf::copyFromAccessor<glm::vec3>(asset, asset.accessors[attribute->accessorIndex], translations.data());
 				}
-
-				const fastgltf::Attribute* tangentAccessorIndex;
-				if((tangentAccessorIndex = curPrimitive.findAttribute("TANGENT")) != curPrimitive.attributes.cend()) {
-					const fastgltf::Accessor& tangentAccessor = asset.accessors[tangentAccessorIndex->accessorIndex];
-					fastgltf::iterateAccessorWithIndex<glm::vec4>(asset, tangentAccessor, [&vertices, oldVerticesSize, normalTransform](glm::vec4 tangent, u64 index) {
-						vertices[index + oldVerticesSize].tangent = glm::vec4(glm::normalize(glm::vec3(normalTransform * glm::vec4(glm::vec3(tangent), 0.0f))), tangent.w);
+				if(auto attribute = curNode.findInstancingAttribute("ROTATION"); attribute != curNode.instancingAttributes.cend()) {
+					// may be normalized integers, which copyFromAccessor wouldn't convert
+					fastgltf::iterateAccessorWithIndex<glm::vec4>(asset, asset.accessors[attribute->accessorIndex], [&rotations](glm::vec4 rotation, u64 index) {
+						rotations[index] = glm::quat(rotation.w, rotation.x, rotation.y, rotation.z);
 					});
 				}
-				else if(uvAccessorIndex != curPrimitive.attributes.cend()) {
-					struct UsrPtr {
-						const u64 vertexOffset;
-						const u64 indexOffset;
-						std::vector<Vertex>& vertices;
-						std::vector<u32>& indices;
-					} usrPtr{ oldVerticesSize, oldIndicesSize, vertices, indices };
-
-					SMikkTSpaceInterface interface {
-						[](const SMikkTSpaceContext* ctx) -> i32 {
-							UsrPtr* data = static_cast<UsrPtr*>(ctx->m_pUserData);
-								return (data->indices.size() - data->indexOffset) / 3;
-							},
-							[](const SMikkTSpaceContext*, const i32) -> i32 {
-								return 3;
-							},
-							[](const SMikkTSpaceContext* ctx, f32 outPos[], const i32 face, const i32 vert) {
-								UsrPtr* data = static_cast<UsrPtr*>(ctx->m_pUserData);
-								memcpy(outPos, &data->vertices[data->indices[data->indexOffset + face * 3 + vert]].position, sizeof(glm::vec3));
-							},
-							[](const SMikkTSpaceContext* ctx, f32 outNorm[], const i32 face, const i32 vert) {
-								UsrPtr* data = static_cast<UsrPtr*>(ctx->m_pUserData);
-								memcpy(outNorm, &data->vertices[data->vertexOffset + data->indices[data->indexOffset + face * 3 + vert]].normal, sizeof(glm::vec3));
-							},
-							[](const SMikkTSpaceContext* ctx, f32 outUV[], const i32 face, const i32 vert) {
-								UsrPtr* data = static_cast<UsrPtr*>(ctx->m_pUserData);
-								memcpy(outUV, &data->vertices[data->vertexOffset + data->indices[data->indexOffset + face * 3 + vert]].uv, sizeof(glm::vec2));
-							},
-							[](const SMikkTSpaceContext* ctx, const f32 inTangent[], const f32 sign, const i32 face, const i32 vert) {
-								UsrPtr* data = static_cast<UsrPtr*>(ctx->m_pUserData);
-								u64 vertexIndex = data->vertexOffset + data->indices[data->indexOffset + face * 3 + vert];
-								memcpy(&data->vertices[vertexIndex].tangent, inTangent, sizeof(glm::vec3));
-								data->vertices[vertexIndex].tangent.w = sign;
-							}
-					};
-					SMikkTSpaceContext ctx{ &interface, &usrPtr };
-					genTangSpaceDefault(&ctx);
+				if(auto attribute = curNode.findInstancingAttribute("SCALE"); attribute != curNode.instancingAttributes.cend()) {
+					fastgltf::copyFromAccessor<glm::vec3>(asset, asset.accessors[attribute->accessorIndex], scales.data());
 				}
 
-				VkDrawIndexedIndirectCommand cmd = { indices.size() - oldIndicesSize, 1, oldIndicesSize, oldVerticesSize, curPrimitive.materialIndex.value() };
+				for(u64 i = 0; i < count; i++) {
+					instanceTransforms.push_back(glm::mat4x3(transform
+						* glm::translate(glm::mat4{ 1.0f }, translations[i])
+						* glm::toMat4(rotations[i])
+						* glm::scale(glm::mat4{ 1.0f }, scales[i])));
+				}
+			}
+			const glm::mat4 vertexTransform = instanceTransforms.empty() ? transform : glm::mat4(1.0f);
+			if(instanceTransforms.empty()) {
+				instanceTransforms.push_back(glm::mat4x3(1.0f));
+			}
+
+			for(const fastgltf::Primitive& curPrimitive : asset.meshes[curNode.meshIndex.value()].primitives) {
+				const u64 primitiveVertices = asset.accessors[curPrimitive.findAttribute("POSITION")->accessorIndex].count;
+				const u64 primitiveIndices = asset.accessors[curPrimitive.indicesAccessor.value()].count;
+				VkDrawIndexedIndirectCommand cmd = { primitiveIndices, static_cast<u32>(instanceTransforms.size()), numIndices, numVertices, instances.size() };
 
 				if(asset.materials[curPrimitive.materialIndex.value()].alphaMode == fastgltf::AlphaMode::Blend) {
 					blendDrawCmds.push_back(cmd);
@@ -383,6 +647,13 @@ void Renderer::createModel(std::filesystem::path path) {
 				else {
 					opaqueDrawCmds.push_back(cmd);
 				}
+
+				primitiveInstances.push_back(PrimitiveInstance{ &curPrimitive, vertexTransform, numVertices, numIndices, primitiveVertices, primitiveIndices, instances.size(), instanceTransforms.size() });
+				for(const glm::mat4x3& instanceTransform : instanceTransforms) {
+					instances.push_back(Instance{ instanceTransform, static_cast<u32>(curPrimitive.materialIndex.value()) });
+				}
+				numVertices += primitiveVertices;
+				numIndices += primitiveIndices;
 			}
 		}
 		for(u64 i : curNode.children) {
@@ -395,76 +666,314 @@ void Renderer::createModel(std::filesystem::path path) {
 		processNode(i, transform);
 	}
 
+	// the totals let the vertex and index buffers be created up front, and each primitive go into them as soon as it's converted instead of the whole scene being collected first
+	// like createUploadBuffer, they're written in place when there's host visible device local memory to spare, and through the staging chunks otherwise
+	auto createStreamTarget = [&](u64 size, VkBufferUsageFlags usage, void** hostPtr) {
+		const b8 direct = size <= getDirectUploadBudget();
+		Buffer buffer = direct
+			? createBuffer(size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+			: createBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		*hostPtr = direct ? buffer.hostPtr : nullptr;
+		return buffer;
+	};
+
+	void* vertexHostPtr;
+	void* indexHostPtr;
+	Buffer vertexBuffer = createStreamTarget(numVertices * sizeof(Vertex), VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, &vertexHostPtr);
+	Buffer indexBuffer = createStreamTarget(numIndices * sizeof(u32), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, &indexHostPtr);
+
+	auto streamToBuffer = [&](const Buffer& dst, void* dstHostPtr, u64 offset, std::span<const std::byte> bytes) {
+		if(dstHostPtr) {
+			memcpy(reinterpret_cast<char*>(dstHostPtr) + offset, bytes.data(), bytes.size());
+			return;
+		}
+
+		while(!bytes.empty()) {
+			StagingChunk& chunk = reserveStaging(std::min<u64>(bytes.size(), 16));
+			const u64 size = std::min<u64>(bytes.size(), chunkSize - chunk.used);
+			memcpy(reinterpret_cast<char*>(chunk.buffer.hostPtr) + chunk.used, bytes.data(), size);
+			vkCmdCopyBuffer(chunk.cmd, chunk.buffer.buffer, dst.buffer, 1, ptr(VkBufferCopy{ chunk.used, offset, size }));
+			chunk.used = (chunk.used + size + 15) & ~15ull;
+			offset += size;
+			bytes = bytes.subspan(size);
+		}
+	};
+
+	struct PrimitiveGeometry {
+		std::vector<Vertex> vertices;
+		std::vector<u32> indices;
+		AABB aabb;
+		std::vector<glm::vec3> vec3Scratch; // attributes as copied out of their accessors, before they're transformed into the vertices
+		std::vector<glm::vec4> vec4Scratch;
+	};
+
+	auto convertPrimitive = [&asset](const PrimitiveInstance& instance, PrimitiveGeometry& geometry) {
+		const fastgltf::Primitive& primitive = *instance.primitive;
+		const glm::mat4 transform = instance.transform;
+		const glm::mat3 normalTransform{ glm::transpose(glm::inverse(transform)) };
+		std::vector<Vertex>& vertices = geometry.vertices;
+		std::vector<u32>& indices = geometry.indices;
+		AABB& aabb = geometry.aabb;
+		aabb = AABB{};
+
+		// whole accessors are copied out at once (straight into the vertices when nothing needs transforming) and then converted in bulk, rather than element by element through a callback
+		const fastgltf::Accessor& indexAccessor = asset.accessors[primitive.indicesAccessor.value()];
+		indices.resize(indexAccessor.count);
+		fastgltf::copyFromAccessor<u32>(asset, indexAccessor, indices.data());
+
+		// KHR_mesh_quantization lets positions, normals and tangents be integers, normalized ones for the latter two (and often for positions)
+		// copyFromAccessor casts integers without applying the normalization, so normalized accessors are converted element by element instead
+		auto copyAttribute = [&asset]<typename T>(const fastgltf::Accessor& accessor, T* dst) {
+			if(accessor.normalized) {
+				fastgltf::iterateAccessorWithIndex<T>(asset, accessor, [dst](T value, u64 index) {
+					dst[index] = value;
+				});
+			}
+			else {
+				fastgltf::copyFromAccessor<T>(asset, accessor, dst);
+			}
+		};
+
+		const fastgltf::Accessor& positionAccessor = asset.accessors[primitive.findAttribute("POSITION")->accessorIndex];
+		vertices.assign(positionAccessor.count, Vertex{});
+		geometry.vec3Scratch.resize(positionAccessor.count);
+		copyAttribute(positionAccessor, geometry.vec3Scratch.data());
+		transformPositions(geometry.vec3Scratch, transform, vertices, aabb.min, aabb.max);
+
+		const fastgltf::Accessor& normalAccessor = asset.accessors[primitive.findAttribute("NORMAL")->accessorIndex];
+		copyAttribute(normalAccessor, geometry.vec3Scratch.data());
+		transformNormals(geometry.vec3Scratch, normalTransform, vertices);
+
+		const fastgltf::Attribute* uvAccessorIndex;
+		if((uvAccessorIndex = primitive.findAttribute("TEXCOORD_0")) != primitive.attributes.cend()) {
+			const fastgltf::Accessor& uvAccessor = asset.accessors[uvAccessorIndex->accessorIndex];
+			// copyFromAccessor converts without applying normalization, which texture coordinates stored as integers rely on
+			if(uvAccessor.normalized) {
+				fastgltf::iterateAccessorWithIndex<glm::vec2>(asset, uvAccessor, [&vertices](glm::vec2 uv, u64 index) {
+					vertices[index].uv = uv;
+				});
+			}
+			else {
+				fastgltf::copyFromAccessor<glm::vec2, sizeof(Vertex)>(asset, uvAccessor, &vertices[0].uv);
+			}
+		}
+
+		const fastgltf::Attribute* tangentAccessorIndex;
+		if((tangentAccessorIndex = primitive.findAttribute("TANGENT")) != primitive.attributes.cend()) {
+			const fastgltf::Accessor& tangentAccessor = asset.accessors[tangentAccessorIndex->accessorIndex];
+			geometry.vec4Scratch.resize(tangentAccessor.count);
+			copyAttribute(tangentAccessor, geometry.vec4Scratch.data());
+			transformTangents(geometry.vec4Scratch, normalTransform, vertices);
+		}
+		else if(uvAccessorIndex != primitive.attributes.cend()) {
+			struct UsrPtr {
+				std::vector<Vertex>& vertices;
+				std::vector<u32>& indices;
+			} usrPtr{ vertices, indices };
+
+			SMikkTSpaceInterface interface {
+				[](const SMikkTSpaceContext* ctx) -> i32 {
+					UsrPtr* data = static_cast<UsrPtr*>(ctx->m_pUserData);
+						return data->indices.size() / 3;
+					},
+					[](const SMikkTSpaceContext*, const i32) -> i32 {
+						return 3;
+					},
+					[](const SMikkTSpaceContext* ctx, f32 outPos[], const i32 face, const i32 vert) {
+						UsrPtr* data = static_cast<UsrPtr*>(ctx->m_pUserData);
+						memcpy(outPos, &data->vertices[data->indices[face * 3 + vert]].position, sizeof(glm::vec3));
+					},
+					[](const SMikkTSpaceContext* ctx, f32 outNorm[], const i32 face, const i32 vert) {
+						UsrPtr* data = static_cast<UsrPtr*>(ctx->m_pUserData);
+						memcpy(outNorm, &data->vertices[data->indices[face * 3 + vert]].normal, sizeof(glm::vec3));
+					},
+					[](const SMikkTSpaceContext* ctx, f32 outUV[], const i32 face, const i32 vert) {
+						UsrPtr* data = static_cast<UsrPtr*>(ctx->m_pUserData);
+						memcpy(outUV, &data->vertices[data->indices[face * 3 + vert]].uv, sizeof(glm::vec2));
+					},
+					[](const SMikkTSpaceContext* ctx, const f32 inTangent[], const f32 sign, const i32 face, const i32 vert) {
+						UsrPtr* data = static_cast<UsrPtr*>(ctx->m_pUserData);
+						u64 vertexIndex = data->indices[face * 3 + vert];
+						memcpy(&data->vertices[vertexIndex].tangent, inTangent, sizeof(glm::vec3));
+						data->vertices[vertexIndex].tangent.w = sign;
+					}
+			};
+			SMikkTSpaceContext ctx{ &interface, &usrPtr };
+			genTangSpaceDefault(&ctx);
+		}
+	};
+
+	// converted a batch at a time, a batch being about as much geometry as fits in a staging chunk, so the host holds little more than the staging budget
+	// the batch is then streamed out serially, since the chunks are filled and submitted in order
+	std::vector<PrimitiveGeometry> batch;
+	for(u64 first = 0; first < primitiveInstances.size();) {
+		u64 last = first;
+		u64 batchSize = 0;
+		do {
+			batchSize += primitiveInstances[last].numVertices * sizeof(Vertex) + primitiveInstances[last].numIndices * sizeof(u32);
+			last++;
+		} while(last < primitiveInstances.size() && batchSize + primitiveInstances[last].numVertices * sizeof(Vertex) + primitiveInstances[last].numIndices * sizeof(u32) <= chunkSize);
+
+		batch.resize(std::max<u64>(batch.size(), last - first));
+		std::for_each(std::execution::par, primitiveInstances.begin() + first, primitiveInstances.begin() + last, [&](const PrimitiveInstance& instance) {
+			convertPrimitive(instance, batch[&instance - &primitiveInstances[first]]);
+		});
+
+		for(u64 i = first; i < last; i++) {
+			const PrimitiveInstance& instance = primitiveInstances[i];
+			const PrimitiveGeometry& geometry = batch[i - first];
+			const b8 blend = asset.materials[instance.primitive->materialIndex.value()].alphaMode == fastgltf::AlphaMode::Blend;
+			// the corners of the box around each instance, exact for the identity instance of geometry that isn't instanced
+			for(u64 j = instance.firstInstance; j < instance.firstInstance + instance.numInstances; j++) {
+				for(u32 k = 0; k < 8; k++) {
+					const glm::vec3 corner = instances[j].transform * glm::vec4(k & 1 ? geometry.aabb.max.x : geometry.aabb.min.x, k & 2 ? geometry.aabb.max.y : geometry.aabb.min.y, k & 4 ? geometry.aabb.max.z : geometry.aabb.min.z, 1.0f);
+					aabb.min = glm::min(aabb.min, corner);
+					aabb.max = glm::max(aabb.max, corner);
+					if(blend) {
+						blendAABB.min = glm::min(blendAABB.min, corner);
+						blendAABB.max = glm::max(blendAABB.max, corner);
+					}
+				}
+			}
+
+			streamToBuffer(vertexBuffer, vertexHostPtr, instance.vertexOffset * sizeof(Vertex), std::as_bytes(std::span(geometry.vertices)));
+			streamToBuffer(indexBuffer, indexHostPtr, instance.indexOffset * sizeof(u32), std::as_bytes(std::span(geometry.indices)));
+		}
+		first = last;
+	}
+
+	// sort draws by material permutation so each permutation is one contiguous indirect range
+	// a draw's instances all share its primitive's material, so the first one's stands for the draw
+	// ALPHA_MASK is the top bit, so the alpha tested opaque draws end up as one range at the end
+	auto buildPermutations = [&materials, &instances](std::vector<VkDrawIndexedIndirectCommand>& drawCmds) {
+		std::ranges::stable_sort(drawCmds, {}, [&materials, &instances](const VkDrawIndexedIndirectCommand& cmd) {
+			return materials[instances[cmd.firstInstance].materialIndex].texBitfield;
+		});
+
+		std::vector<MaterialPermutation> permutations;
+		for(const auto& [idx, cmd] : std::views::enumerate(drawCmds)) {
+			const u32 texBitfield = materials[instances[cmd.firstInstance].materialIndex].texBitfield;
+			if(permutations.empty() || permutations.back().texBitfield != texBitfield) {
+				permutations.push_back(MaterialPermutation{ .texBitfield = texBitfield, .firstDrawCommand = static_cast<u64>(idx) });
+			}
+			permutations.back().numDrawCommands++;
+		}
+		return permutations;
+	};
+
+	std::vector<MaterialPermutation> opaquePermutations = buildPermutations(opaqueDrawCmds);
+	std::vector<MaterialPermutation> blendPermutations = buildPermutations(blendDrawCmds);
+
+	u64 numAlphaTestedDrawCommands = 0;
+	for(const MaterialPermutation& permutation : opaquePermutations) {
+		if(permutation.texBitfield & ALPHA_MASK) {
+			numAlphaTestedDrawCommands += permutation.numDrawCommands;
+		}
+	}
+
+	std::vector<std::future<void>> pipelineJobs;
+	for(MaterialPermutation& permutation : opaquePermutations) {
+		pipelineJobs.push_back(std::async(std::launch::async, [this, &permutation] { permutation.pipeline = createPermutationPipeline(permutation, false); }));
+	}
+	for(MaterialPermutation& permutation : blendPermutations) {
+		pipelineJobs.push_back(std::async(std::launch::async, [this, &permutation] { permutation.pipeline = createPermutationPipeline(permutation, true); }));
+	}
+
+	// visibility ids are the opaque draw index above the triangle index, with just enough bits for the draw index that no id comes out as VISIBILITY_EMPTY
+	const u32 visibilityDrawBits = std::bit_width(opaqueDrawCmds.size());
+	// and have no room for an instance index, so instanced opaque geometry keeps the model on the forward path
+	u64 maxOpaqueTriangles = 0;
+	b8 opaqueInstanced = false;
+	for(const VkDrawIndexedIndirectCommand& cmd : opaqueDrawCmds) {
+		maxOpaqueTriangles = std::max<u64>(maxOpaqueTriangles, cmd.indexCount / 3);
+		opaqueInstanced = opaqueInstanced || cmd.instanceCount > 1;
+	}
+
+	// the visibility prepass writes ids without a fragment shader to discard with, so alpha tested geometry keeps the model forward too
+	VkPipeline visibilityPipeline = {};
+	VkPipeline materialPipeline = {};
+	if(m_visibilityBufferSupported && !opaqueDrawCmds.empty() && !opaqueInstanced && numAlphaTestedDrawCommands == 0 && maxOpaqueTriangles <= (1ull << (32 - visibilityDrawBits))) {
+		pipelineJobs.push_back(std::async(std::launch::async, [this, &visibilityPipeline, visibilityDrawBits] { visibilityPipeline = createVisibilityPipeline(visibilityDrawBits, false); }));
+		pipelineJobs.push_back(std::async(std::launch::async, [this, &materialPipeline, visibilityDrawBits] { materialPipeline = createVisibilityPipeline(visibilityDrawBits, true); }));
+	}
+
 	const glm::vec3 center = (aabb.max + aabb.min) / 2.0f;
 	const glm::vec3 size = aabb.max - aabb.min;
 	const f32 scale = 1.0f / std::max(size.x, std::max(size.y, size.z));
 
 	const glm::mat4 baseTransform = glm::scale(glm::mat4(1.0f), glm::vec3(scale)) * glm::translate(glm::mat4(1.0f), -center);
 
-	const u64 vertexBufferByteSize = vertices.size() * sizeof(Vertex);
-	const u64 indexBufferByteSize = indices.size() * sizeof(u32);
-	const u64 opaqueIndirectBufferByteSize = opaqueDrawCmds.size() * sizeof(VkDrawIndexedIndirectCommand);
-	const u64 blendIndirectBufferByteSize = blendDrawCmds.size() * sizeof(VkDrawIndexedIndirectCommand);
-	const u64 indirectBufferByteSize = opaqueIndirectBufferByteSize + blendIndirectBufferByteSize;
-	Buffer stagingVertexBuffer = createBuffer(vertexBufferByteSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	Buffer stagingIndexBuffer = createBuffer(indexBufferByteSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	Buffer stagingIndirectBuffer = createBuffer(indirectBufferByteSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	Buffer vertexBuffer = createBuffer(vertexBufferByteSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	Buffer indexBuffer = createBuffer(indexBufferByteSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	Buffer indirectBuffer = createBuffer(indirectBufferByteSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-	memcpy(stagingVertexBuffer.hostPtr, vertices.data(), vertexBufferByteSize);
-	memcpy(stagingIndexBuffer.hostPtr, indices.data(), indexBufferByteSize);
-	memcpy(stagingIndirectBuffer.hostPtr, opaqueDrawCmds.data(), opaqueIndirectBufferByteSize);
-	memcpy(reinterpret_cast<char*>(stagingIndirectBuffer.hostPtr) + opaqueIndirectBufferByteSize, blendDrawCmds.data(), blendIndirectBufferByteSize);
-	
-	vkCmdCopyBuffer(m_transferCmd, stagingVertexBuffer.buffer, vertexBuffer.buffer, 1, ptr(VkBufferCopy{ .size = vertexBufferByteSize }));
-	vkCmdCopyBuffer(m_transferCmd, stagingIndexBuffer.buffer, indexBuffer.buffer, 1, ptr(VkBufferCopy{ .size = indexBufferByteSize }));
-	vkCmdCopyBuffer(m_transferCmd, stagingIndirectBuffer.buffer, indirectBuffer.buffer, 1, ptr(VkBufferCopy{ .size = indirectBufferByteSize }));
+	// world space box that contains the blended geometry at any rotation, used to size the OIT buffer once rather than every frame
+	f32 blendRadius = 0.0f;
+	for(u32 i = 0; i < 8 && !blendDrawCmds.empty(); i++) {
+		const glm::vec3 corner = { i & 1 ? blendAABB.max.x : blendAABB.min.x, i & 2 ? blendAABB.max.y : blendAABB.min.y, i & 4 ? blendAABB.max.z : blendAABB.min.z };
+		blendRadius = std::max(blendRadius, glm::length(glm::vec3(baseTransform * glm::vec4(corner, 1.0f))));
+	}
+	const AABB blendBounds = { glm::vec3(-blendRadius), glm::vec3(blendRadius) };
+
+	// the directly written stream targets swap their mapping for a device address, like createUploadBuffer does
+	for(auto [buffer, hostPtr] : { std::pair{ &vertexBuffer, vertexHostPtr }, std::pair{ &indexBuffer, indexHostPtr } }) {
+		if(hostPtr) {
+			vkUnmapMemory(m_device, buffer->memory);
+			buffer->devicePtr = vkGetBufferDeviceAddress(m_device, ptr(VkBufferDeviceAddressInfo{ .buffer = buffer->buffer }));
+		}
+	}
+
+	Buffer instanceBuffer = createUploadBuffer(VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, { std::as_bytes(std::span(instances)) }, stagingBuffers);
+	Buffer indirectBuffer = createUploadBuffer(VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, { std::as_bytes(std::span(opaqueDrawCmds)), std::as_bytes(std::span(blendDrawCmds)) }, stagingBuffers);
+	Buffer lightBuffer = lights.empty() ? Buffer{} : createUploadBuffer(VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, { std::as_bytes(std::span(lights)) }, stagingBuffers);
+	submitChunk();
 	vkEndCommandBuffer(m_transferCmd);
 
 	vkQueueSubmit2(m_transferQueue, 1, ptr(VkSubmitInfo2{
 		.commandBufferInfoCount = 1,
-		.pCommandBufferInfos = ptr(VkCommandBufferSubmitInfo{.commandBuffer = m_transferCmd }),
-		.signalSemaphoreInfoCount = 1,
-		.pSignalSemaphoreInfos = ptr(VkSemaphoreSubmitInfo{
-			.semaphore = m_transferToComputeSem,
-			.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT
-		})
-	}), nullptr);
-
-	vkQueueSubmit2(m_computeQueue, 1, ptr(VkSubmitInfo2{
-		.waitSemaphoreInfoCount = 1,
-		.pWaitSemaphoreInfos = ptr(VkSemaphoreSubmitInfo{
-			.semaphore = m_transferToComputeSem,
-			.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT
-		}),
-		.commandBufferInfoCount = 1,
-		.pCommandBufferInfos = ptr(VkCommandBufferSubmitInfo{.commandBuffer = m_computeCmd })
+		.pCommandBufferInfos = ptr(VkCommandBufferSubmitInfo{.commandBuffer = m_transferCmd })
 	}), nullptr);
 
 	vkQueueWaitIdle(m_transferQueue);
 
-	for(Buffer i : imageStagingBuffers) {
+	for(Buffer i : stagingBuffers) {
 		destroyBuffer(i);
 	}
 
-	destroyBuffer(stagingMaterialBuffer);
-	destroyBuffer(stagingVertexBuffer);
-	destroyBuffer(stagingIndexBuffer);
-	destroyBuffer(stagingIndirectBuffer);
-
 	vkResetCommandPool(m_device, m_transferPool, 0);
 
 	vkQueueWaitIdle(m_computeQueue);
 
+	for(StagingChunk& chunk : chunks) {
+		for(Buffer i : chunk.oversized) {
+			destroyBuffer(i);
+		}
+		destroyBuffer(chunk.buffer);
+		vkDestroySemaphore(m_device, chunk.copiedSem, nullptr);
+		vkDestroyFence(m_device, chunk.fence, nullptr);
+	}
+	vkDestroyCommandPool(m_device, chunkPool, nullptr);
+	vkDestroyCommandPool(m_device, mipPool, nullptr);
+
 	for(VkImageView i : mipViews) {
 		vkDestroyImageView(m_device, i, nullptr);
 	}
 
-	vkResetCommandPool(m_device, m_computePool, 0);
+	for(std::future<void>& job : pipelineJobs) {
+		job.wait();
+	}
+
+#ifdef SHADER_HOT_RELOAD
+	std::scoped_lock lock(m_pipelineRecipesMutex);
+#endif
+	m_model = Model{ std::move(images), std::move(samplers), pool, set, materialBuffer, vertexBuffer, indexBuffer, instanceBuffer, indirectBuffer, lightBuffer, baseTransform, aabb, blendAABB, blendBounds, opaqueDrawCmds.size(), numAlphaTestedDrawCommands, blendDrawCmds.size(), lights.size(), std::move(opaquePermutations), std::move(blendPermutations), visibilityDrawBits, visibilityPipeline, materialPipeline };
 
-	m_model = Model{ std::move(images), std::move(samplers), pool, set, materialBuffer, vertexBuffer, indexBuffer, indirectBuffer, baseTransform, aabb, opaqueDrawCmds.size(), blendDrawCmds.size() };
+	for(MaterialPermutation& permutation : m_model.opaquePermutations) {
+		m_pipelineRecipes.push_back({ &permutation.pipeline, [this, &permutation] { return createPermutationPipeline(permutation, false); } });
+	}
+	for(MaterialPermutation& permutation : m_model.blendPermutations) {
+		m_pipelineRecipes.push_back({ &permutation.pipeline, [this, &permutation] { return createPermutationPipeline(permutation, true); } });
+	}
+	if(m_model.visibilityPipeline) {
+		m_pipelineRecipes.push_back({ &m_model.visibilityPipeline, [this] { return createVisibilityPipeline(m_model.visibilityDrawBits, false); } });
+		m_pipelineRecipes.push_back({ &m_model.materialPipeline, [this] { return createVisibilityPipeline(m_model.visibilityDrawBits, true); } });
+	}
 }
 
 void Renderer::destroyModel(Model model) {
@@ -478,8 +987,37 @@ void Renderer::destroyModel(Model model) {
 
 	vkDestroyDescriptorPool(m_device, model.texPool, nullptr);
 
+#ifdef SHADER_HOT_RELOAD
+	std::scoped_lock lock(m_pipelineRecipesMutex);
+#endif
+	for(const std::vector<MaterialPermutation>* permutations : { &model.opaquePermutations, &model.blendPermutations }) {
+		for(const MaterialPermutation& permutation : *permutations) {
+			std::erase_if(m_pipelineRecipes, [&permutation](const PipelineRecipe& recipe) {
+				return *recipe.pipeline == permutation.pipeline;
+			});
+#ifdef SHADER_HOT_RELOAD
+			discardReloadedPipeline(permutation.pipeline);
+#endif
+			vkDestroyPipeline(m_device, permutation.pipeline, nullptr);
+		}
+	}
+
+	if(model.visibilityPipeline) {
+		std::erase_if(m_pipelineRecipes, [&model](const PipelineRecipe& recipe) {
+			return *recipe.pipeline == model.visibilityPipeline || *recipe.pipeline == model.materialPipeline;
+		});
+#ifdef SHADER_HOT_RELOAD
+		discardReloadedPipeline(model.visibilityPipeline);
+		discardReloadedPipeline(model.materialPipeline);
+#endif
+		vkDestroyPipeline(m_device, model.visibilityPipeline, nullptr);
+		vkDestroyPipeline(m_device, model.materialPipeline, nullptr);
+	}
+
 	destroyBuffer(model.materialBuffer);
 	destroyBuffer(model.vertexBuffer);
 	destroyBuffer(model.indexBuffer);
+	destroyBuffer(model.instanceBuffer);
 	destroyBuffer(model.indirectBuffer);
+	destroyBuffer(model.lightBuffer);
 }
\ No newline at end of file
@@ -3,9 +3,15 @@
 #include <nfd/nfd_glfw3.h>
 #include <random>
 #include <numbers>
+#include <future>
+#include <algorithm>
+#include <array>
 #include "../shared/vertex.h"
+#include "../shared/cluster.h"
+#include "../shared/bloom.h"
 
-Renderer::Renderer() {
+// the budget is kept to at least a megabyte, the geometry streams through it 16 bytes at a time at the least
+Renderer::Renderer(u64 importStagingBudget) : m_importStagingBudget(std::max<u64>(importStagingBudget, 1ull << 20)) {
 	// glfw and NFD
 	{
 		glfwInit();
@@ -15,12 +21,18 @@ Renderer::Renderer() {
 		m_width = mode->width * 3 / 4;
 		m_height = mode->height * 3 / 4;
 
+		// dynamic resolution aims a little under the refresh interval to leave room for timing noise
+		m_gpuTimeBudget = 0.9f / static_cast<f32>(mode->refreshRate);
+
 		m_window = glfwCreateWindow(m_width, m_height, "Capstone", nullptr, nullptr);
 
 		glfwSetWindowUserPointer(m_window, this);
 		glfwSetFramebufferSizeCallback(m_window, [](GLFWwindow* window, i32 width, i32 height) {
 			reinterpret_cast<Renderer*>(glfwGetWindowUserPointer(window))->onResize();
 		});
+		glfwSetKeyCallback(m_window, [](GLFWwindow* window, i32 key, i32 scancode, i32 action, i32 mods) {
+			reinterpret_cast<Renderer*>(glfwGetWindowUserPointer(window))->onKey(key, action);
+		});
 
 		NFD_Init();
 		NFD_GetNativeWindowFromGLFWWindow(m_window, &m_nativeHandle);
@@ -43,7 +55,7 @@ Renderer::Renderer() {
 		volkLoadInstanceOnly(m_instance);
 	}
 
-	// VkPhysicalDevice, VkPhysicalDeviceMemoryProperties, and VkPhysicalDeviceProperties::limits::maxPerStageDescriptorSampledImages
+	// VkPhysicalDevice, VkPhysicalDeviceMemoryProperties, VkPhysicalDeviceProperties::limits::maxPerStageDescriptorSampledImages, and optional feature support
 	{
 		vkEnumeratePhysicalDevices(m_instance, ptr(1u), &m_physicalDevice);
 		vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &m_memProps);
@@ -51,6 +63,47 @@ Renderer::Renderer() {
 		VkPhysicalDeviceProperties props;
 		vkGetPhysicalDeviceProperties(m_physicalDevice, &props);
 		m_maxSampledImageDescriptors = std::min(props.limits.maxPerStageDescriptorSampledImages, props.limits.maxPerStageDescriptorSamplers) - 4;
+		m_gpuTimingSupported = props.limits.timestampComputeAndGraphics;
+		m_timestampPeriod = props.limits.timestampPeriod;
+
+		u32 numExtensions;
+		vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &numExtensions, nullptr);
+		std::vector<VkExtensionProperties> extensions(numExtensions);
+		vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &numExtensions, extensions.data());
+
+		auto hasExtension = [&](std::string_view name) {
+			return std::ranges::any_of(extensions, [&](const VkExtensionProperties& ext) { return name == ext.extensionName; });
+		};
+
+		if(hasExtension(VK_KHR_PRESENT_ID_EXTENSION_NAME) && hasExtension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+			VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+			VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = { .pNext = &presentIdFeatures };
+			vkGetPhysicalDeviceFeatures2(m_physicalDevice, ptr(VkPhysicalDeviceFeatures2{ .pNext = &presentWaitFeatures }));
+			m_presentWaitSupported = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+		}
+
+		// without pixel interlock, transparency falls back to weighted blended OIT
+		if(hasExtension(VK_EXT_FRAGMENT_SHADER_INTERLOCK_EXTENSION_NAME)) {
+			VkPhysicalDeviceFragmentShaderInterlockFeaturesEXT interlockFeatures = {};
+			vkGetPhysicalDeviceFeatures2(m_physicalDevice, ptr(VkPhysicalDeviceFeatures2{ .pNext = &interlockFeatures }));
+			m_fragmentShaderInterlockSupported = interlockFeatures.fragmentShaderPixelInterlock;
+		}
+		m_weightedBlendedOIT = !m_fragmentShaderInterlockSupported;
+
+		// device local memory the CPU can write directly: all of it on UMA and software devices, a 256MB window or (with resizable BAR) all of VRAM on discrete GPUs
+		for(u32 idx = 0; idx < m_memProps.memoryTypeCount; idx++) {
+			constexpr VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			if((m_memProps.memoryTypes[idx].propertyFlags & flags) == flags) {
+				m_directUploadMemoryType = idx;
+				break;
+			}
+		}
+		m_memoryBudgetSupported = hasExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+		// the visibility prepass writes gl_PrimitiveID from the fragment shader, which needs the geometry shader feature
+		VkPhysicalDeviceFeatures features;
+		vkGetPhysicalDeviceFeatures(m_physicalDevice, &features);
+		m_visibilityBufferSupported = features.geometryShader;
 	}
 
 	// VkDevice and VkQueues
@@ -58,6 +111,34 @@ Renderer::Renderer() {
 		m_graphicsQueueFamily = getQueue(VK_QUEUE_GRAPHICS_BIT);
 		m_computeQueueFamily = getQueue(VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
 		m_transferQueueFamily = getQueue(VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+
+		std::vector<const char*> extensions = {
+			VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+			VK_EXT_ROBUSTNESS_2_EXTENSION_NAME,
+			VK_KHR_SHADER_MAXIMAL_RECONVERGENCE_EXTENSION_NAME
+		};
+
+		// optional features are chained in front of each other, only for the extensions that get enabled
+		void* optionalFeatures = nullptr;
+		VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = { .presentWait = true };
+		VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = { .pNext = &presentWaitFeatures, .presentId = true };
+		VkPhysicalDeviceFragmentShaderInterlockFeaturesEXT interlockFeatures = { .fragmentShaderPixelInterlock = true };
+
+		if(m_presentWaitSupported) {
+			extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+			extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+			presentWaitFeatures.pNext = optionalFeatures;
+			optionalFeatures = &presentIdFeatures;
+		}
+		if(m_fragmentShaderInterlockSupported) {
+			extensions.push_back(VK_EXT_FRAGMENT_SHADER_INTERLOCK_EXTENSION_NAME);
+			interlockFeatures.pNext = optionalFeatures;
+			optionalFeatures = &interlockFeatures;
+		}
+		if(m_memoryBudgetSupported) {
+			extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		}
+
 		vkCreateDevice(m_physicalDevice, ptr(VkDeviceCreateInfo{
 			.pNext = ptr(VkPhysicalDeviceFeatures2{
 				.pNext = ptr(VkPhysicalDeviceVulkan11Features{
@@ -65,9 +146,9 @@ Renderer::Renderer() {
 						.pNext = ptr(VkPhysicalDeviceVulkan13Features{
 							.pNext = ptr(VkPhysicalDeviceVulkan14Features{
 								.pNext = ptr(VkPhysicalDeviceRobustness2FeaturesEXT{
-									.pNext = ptr(VkPhysicalDeviceFragmentShaderInterlockFeaturesEXT{
-										.pNext = ptr(VkPhysicalDeviceShaderMaximalReconvergenceFeaturesKHR{.shaderMaximalReconvergence = true }),
-										.fragmentShaderPixelInterlock = true
+									.pNext = ptr(VkPhysicalDeviceShaderMaximalReconvergenceFeaturesKHR{
+										.pNext = optionalFeatures,
+										.shaderMaximalReconvergence = true
 									}),
 									.nullDescriptor = true
 								}),
@@ -81,6 +162,7 @@ Renderer::Renderer() {
 						.descriptorBindingVariableDescriptorCount = true,
 						.runtimeDescriptorArray = true,
 						.scalarBlockLayout = true,
+						.timelineSemaphore = true,
 						.bufferDeviceAddress = true,
 						.vulkanMemoryModel = true,
 						.vulkanMemoryModelDeviceScope = true,
@@ -89,10 +171,12 @@ Renderer::Renderer() {
 					.shaderDrawParameters = true,
 				}),
 				.features{
+					.geometryShader = m_visibilityBufferSupported,
 					.multiDrawIndirect = true,
 					.drawIndirectFirstInstance = true,
 					.samplerAnisotropy = true,
 					.fragmentStoresAndAtomics = true,
+					.shaderStorageImageArrayDynamicIndexing = true,
 					.shaderInt64 = true,
 				}
 			}),
@@ -114,13 +198,8 @@ Renderer::Renderer() {
 					.pQueuePriorities = ptr(1.0f)
 				}
 			}),
-			.enabledExtensionCount = 4,
-			.ppEnabledExtensionNames = ptr<const char*>({
-				VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-				VK_EXT_ROBUSTNESS_2_EXTENSION_NAME,
-				VK_EXT_FRAGMENT_SHADER_INTERLOCK_EXTENSION_NAME,
-				VK_KHR_SHADER_MAXIMAL_RECONVERGENCE_EXTENSION_NAME
-			}),
+			.enabledExtensionCount = static_cast<u32>(extensions.size()),
+			.ppEnabledExtensionNames = extensions.data(),
 		}), nullptr, &m_device);
 
 		volkLoadDevice(m_device);
@@ -129,57 +208,6 @@ Renderer::Renderer() {
 		vkGetDeviceQueue(m_device, m_transferQueueFamily, 0, &m_transferQueue);
 	}
 
-	// per-frame data (vk::CommandPool, vk::CommandBuffer, vk::Semaphores, vk::Fence)
-	{
-		for(u8 i = 0; i < m_framesInFlight; i++) {
-			vkCreateCommandPool(m_device, ptr(VkCommandPoolCreateInfo{
-				.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
-				.queueFamilyIndex = m_graphicsQueueFamily
-			}), nullptr, &m_perFrameData[i].cmdPool);
-			vkAllocateCommandBuffers(m_device, ptr(VkCommandBufferAllocateInfo{
-				.commandPool = m_perFrameData[i].cmdPool,
-				.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-				.commandBufferCount = 1
-			}), &m_perFrameData[i].cmdBuffer);
-			vkCreateSemaphore(m_device, ptr(VkSemaphoreCreateInfo{}), nullptr, &m_perFrameData[i].acquireSem);
-			vkCreateSemaphore(m_device, ptr(VkSemaphoreCreateInfo{}), nullptr, &m_perFrameData[i].presentSem);
-			vkCreateFence(m_device, ptr(VkFenceCreateInfo{ .flags = VK_FENCE_CREATE_SIGNALED_BIT }), nullptr, &m_perFrameData[i].fence);
-		}
-	}
-
-	// VkSurface and VkSwapchain
-	{
-		glfwCreateWindowSurface(m_instance, m_window, nullptr, &m_surface);
-		vkGetPhysicalDeviceSurfaceFormatsKHR(m_physicalDevice, m_surface, ptr(1u), &m_surfaceFormat);
-
-		createSwapchain();
-	}
-
-	// transfer objects
-	{
-		vkCreateCommandPool(m_device, ptr(VkCommandPoolCreateInfo{
-			.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
-			.queueFamilyIndex = m_transferQueueFamily
-		}), nullptr, &m_transferPool);
-		vkAllocateCommandBuffers(m_device, ptr(VkCommandBufferAllocateInfo{
-			.commandPool = m_transferPool,
-			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-			.commandBufferCount = 1
-		}), &m_transferCmd);
-
-		vkCreateCommandPool(m_device, ptr(VkCommandPoolCreateInfo{
-			.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
-			.queueFamilyIndex = m_computeQueueFamily
-		}), nullptr, &m_computePool);
-		vkAllocateCommandBuffers(m_device, ptr(VkCommandBufferAllocateInfo{
-			.commandPool = m_computePool,
-			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-			.commandBufferCount = 1
-		}), &m_computeCmd);
-
-		vkCreateSemaphore(m_device, ptr(VkSemaphoreCreateInfo{}), nullptr, &m_transferToComputeSem);
-	}
-
 	// compute pipeline layouts
 	{
 		vkCreateDescriptorSetLayout(m_device, ptr(VkDescriptorSetLayoutCreateInfo{
@@ -246,229 +274,288 @@ Renderer::Renderer() {
 			.pSetLayouts = &m_oneTexOneImageSetLayout
 		}), nullptr, &m_oneTexOneImagePipelineLayout);
 
+		// framebuffer and the weighted blended OIT targets, which are null with the interlock backend
+		vkCreateDescriptorSetLayout(m_device, ptr(VkDescriptorSetLayoutCreateInfo{
+			.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT,
+			.bindingCount = 3,
+			.pBindings = ptr({
+				VkDescriptorSetLayoutBinding{
+					.binding = 0,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+					.descriptorCount = 1,
+					.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+				},
+				VkDescriptorSetLayoutBinding{
+					.binding = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+					.descriptorCount = 1,
+					.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+				},
+				VkDescriptorSetLayoutBinding{
+					.binding = 2,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+					.descriptorCount = 1,
+					.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+				}
+			})
+		}), nullptr, &m_oitResolveSetLayout);
+
 		vkCreatePipelineLayout(m_device, ptr(VkPipelineLayoutCreateInfo{
 			.setLayoutCount = 1,
-			.pSetLayouts = &m_twoImageSetLayout,
+			.pSetLayouts = &m_oitResolveSetLayout,
 			.pushConstantRangeCount = 1,
 			.pPushConstantRanges = ptr(VkPushConstantRange{
 				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
 				.offset = 0,
 				.size = sizeof(VkDeviceAddress)
 			})
-		}), nullptr, &m_postprocessingPipelineLayout);
-	}
-
-	// compute pipelines
-	{
-		m_mipPipeline = createComputePipeline(m_twoImagePipelineLayout, "shaders/mip.comp.spv");
-		m_srgbMipPipeline = createComputePipeline(m_twoImagePipelineLayout, "shaders/srgbmip.comp.spv");
-		m_cubePipeline = createComputePipeline(m_oneTexOneImagePipelineLayout, "shaders/cube.comp.spv");
-		m_cubeMipPipeline = createComputePipeline(m_twoImagePipelineLayout, "shaders/cubemip.comp.spv");
-		m_irradiancePipeline = createComputePipeline(m_oneTexOneImagePipelineLayout, "shaders/irradiance.comp.spv");
-		m_radiancePipeline = createComputePipeline(m_oneTexOneImagePipelineLayout, "shaders/radiance.comp.spv");
-		m_brdfIntegralPipeline = createComputePipeline(m_oneImagePipelineLayout, "shaders/brdfintegral.comp.spv");
-		m_postprocessingPipeline = createComputePipeline(m_postprocessingPipelineLayout, "shaders/postprocess.comp.spv");
-	}
-
-	// global samplers
-	{
-		vkCreateSampler(m_device, ptr(VkSamplerCreateInfo{
-			.magFilter = VK_FILTER_LINEAR,
-			.minFilter = VK_FILTER_LINEAR,
-			.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
-			.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-			.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-			.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-			.anisotropyEnable = true,
-			.maxAnisotropy = 16,
-			.maxLod = VK_LOD_CLAMP_NONE
-		}), nullptr, &m_skyboxSampler);
-
-		vkCreateSampler(m_device, ptr(VkSamplerCreateInfo{
-			.magFilter = VK_FILTER_LINEAR,
-			.minFilter = VK_FILTER_LINEAR,
-			.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-			.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-			.compareEnable = true,
-			.compareOp = VK_COMPARE_OP_GREATER
-		}), nullptr, &m_shadowSampler);
-	}
-
-	// generate brdf integral tex
-	{
-		m_brdfIntegralTex = createImage(m_brdfIntegralLUTSize, m_brdfIntegralLUTSize, VK_FORMAT_R16G16_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-
-		vkBeginCommandBuffer(m_computeCmd, ptr(VkCommandBufferBeginInfo{ .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT }));
-		
-		vkCmdPipelineBarrier2(m_computeCmd, ptr(VkDependencyInfo{
-			.imageMemoryBarrierCount = 1,
-			.pImageMemoryBarriers = ptr(VkImageMemoryBarrier2{
-				.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
-				.dstAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
-				.newLayout = VK_IMAGE_LAYOUT_GENERAL,
-				.image = m_brdfIntegralTex.image,
-				.subresourceRange = colorSubresourceRange()
-			})
-		}));
-
-		vkCmdBindPipeline(m_computeCmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_brdfIntegralPipeline);
-
-		vkCmdPushDescriptorSet(m_computeCmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_oneImagePipelineLayout, 0, 1, ptr(VkWriteDescriptorSet{
-			.descriptorCount = 1,
-			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-			.pImageInfo = ptr(VkDescriptorImageInfo{
-				.imageView = m_brdfIntegralTex.view,
-				.imageLayout = VK_IMAGE_LAYOUT_GENERAL
-			})
-		}));
-
-		vkCmdDispatch(m_computeCmd, (m_brdfIntegralLUTSize + 7) / 8, (m_brdfIntegralLUTSize + 7) / 8, 1);
-
-		vkCmdPipelineBarrier2(m_computeCmd, ptr(VkDependencyInfo{
-			.imageMemoryBarrierCount = 1,
-			.pImageMemoryBarriers = ptr(VkImageMemoryBarrier2{
-				.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
-				.srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
-				.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
-				.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-				.image = m_brdfIntegralTex.image,
-				.subresourceRange = colorSubresourceRange()
-			})
-		}));
-
-		vkEndCommandBuffer(m_computeCmd);
-
-		vkQueueSubmit2(m_computeQueue, 1, ptr(VkSubmitInfo2{
-			.commandBufferInfoCount = 1,
-			.pCommandBufferInfos = ptr(VkCommandBufferSubmitInfo{.commandBuffer = m_computeCmd })
-		}), nullptr);
-
-		vkQueueWaitIdle(m_computeQueue);
-		vkResetCommandPool(m_device, m_computePool, 0);
-	}
-
-	// Allocate Shadow Map
-	{
-		m_shadowMap = createImage(m_shadowMapSize, m_shadowMapSize, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-		
-		u32 poissonDiskBufferSize = m_poissonDiskWindowSize * m_poissonDiskWindowSize * m_poissonDiskFilterSize * m_poissonDiskFilterSize * sizeof(glm::vec2);
-
-		std::vector<glm::vec2> samples;
-		samples.reserve(poissonDiskBufferSize / sizeof(glm::vec2));
-
-		std::default_random_engine generator;
-		std::uniform_real_distribution<f32> distribution(-0.5f, 0.5f);
-
-		for(i32 v = m_poissonDiskFilterSize - 1; v >= 0; v--) {
-			for(i32 u = 0; u < m_poissonDiskFilterSize; u++) {
-				for(i32 i = 0; i < m_poissonDiskWindowSize * m_poissonDiskWindowSize; i++) {
-					f32 x = (u + 0.5f + distribution(generator)) / m_poissonDiskFilterSize;
-					f32 y = (v + 0.5f + distribution(generator)) / m_poissonDiskFilterSize;
-					
-					glm::vec2 sample(std::sqrtf(y) * std::cosf(2.0f * std::numbers::pi_v<f32> * x), std::sqrtf(y) * std::sinf(2.0f * std::numbers::pi_v<f32> * x));
-					samples.push_back(sample);
-				}
-			}
-		}
-
-		Buffer poissonDiskStagingBuffer = createBuffer(poissonDiskBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		m_poissonDiskBuffer = createBuffer(poissonDiskBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		memcpy(poissonDiskStagingBuffer.hostPtr, samples.data(), poissonDiskBufferSize);
-
-		vkBeginCommandBuffer(m_transferCmd, ptr(VkCommandBufferBeginInfo{ .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT }));
-		vkCmdCopyBuffer(m_transferCmd, poissonDiskStagingBuffer.buffer, m_poissonDiskBuffer.buffer, 1, ptr(VkBufferCopy{ .size = poissonDiskBufferSize }));
-		vkEndCommandBuffer(m_transferCmd);
-
-		vkQueueSubmit2(m_transferQueue, 1, ptr(VkSubmitInfo2{
-			.commandBufferInfoCount = 1,
-			.pCommandBufferInfos = ptr(VkCommandBufferSubmitInfo{.commandBuffer = m_transferCmd })
-		}), nullptr);
-
-		vkQueueWaitIdle(m_transferQueue);
-		vkResetCommandPool(m_device, m_transferPool, 0);
-		
-		destroyBuffer(poissonDiskStagingBuffer);
-	}
-
-	// Color Pass Pipelines
-	{
-		vkCreateDescriptorSetLayout(m_device, ptr(VkDescriptorSetLayoutCreateInfo{
-			.pNext = ptr(VkDescriptorSetLayoutBindingFlagsCreateInfo{
-				.bindingCount = 1,
-				.pBindingFlags = ptr<VkDescriptorBindingFlags>(VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT)
-			}),
-			.bindingCount = 1,
-			.pBindings = ptr(VkDescriptorSetLayoutBinding{
-				.binding = 0,
-				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-				.descriptorCount = m_maxSampledImageDescriptors,
-				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
-			})
-		}), nullptr, &m_modelSetLayout);
+		}), nullptr, &m_oitResolvePipelineLayout);
 
+		// framebuffer, depth and last frame's history, then this frame's history
 		vkCreateDescriptorSetLayout(m_device, ptr(VkDescriptorSetLayoutCreateInfo{
 			.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT,
 			.bindingCount = 4,
 			.pBindings = ptr({
 				VkDescriptorSetLayoutBinding{
+					.binding = 0,
 					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 					.descriptorCount = 1,
-					.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+					.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
 				},
 				VkDescriptorSetLayoutBinding{
 					.binding = 1,
 					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 					.descriptorCount = 1,
-					.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+					.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
 				},
 				VkDescriptorSetLayoutBinding{
 					.binding = 2,
 					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 					.descriptorCount = 1,
-					.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+					.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
 				},
 				VkDescriptorSetLayoutBinding{
 					.binding = 3,
-					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
 					.descriptorCount = 1,
-					.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+					.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
 				}
 			})
-		}), nullptr, &m_modelPushDescriptorLayout);
+		}), nullptr, &m_postprocessingSetLayout);
 
 		vkCreatePipelineLayout(m_device, ptr(VkPipelineLayoutCreateInfo{
-			.setLayoutCount = 2,
-			.pSetLayouts = ptr({ m_modelSetLayout, m_modelPushDescriptorLayout }),
+			.setLayoutCount = 1,
+			.pSetLayouts = &m_postprocessingSetLayout,
 			.pushConstantRangeCount = 1,
 			.pPushConstantRanges = ptr(VkPushConstantRange{
-				.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
 				.offset = 0,
-				.size = sizeof(PushConstants),
+				.size = sizeof(PostprocessPushConstants)
 			})
-		}), nullptr, &m_modelPipelineLayout);
-
-		m_opaquePipeline = createGraphicsPipeline(m_modelPipelineLayout, "shaders/model.vert.spv", "shaders/opaque.frag.spv", VK_CULL_MODE_BACK_BIT, VK_COMPARE_OP_EQUAL, false, true);
-		m_blendPipeline = createGraphicsPipeline(m_modelPipelineLayout, "shaders/model.vert.spv", "shaders/blend.frag.spv", VK_CULL_MODE_NONE, VK_COMPARE_OP_GREATER, false, false);
-	}
-
-	// Depth Only Pipelines
-	{
-		m_prepassPipeline = createGraphicsPipeline(m_modelPipelineLayout, "shaders/prepass.vert.spv", std::filesystem::path(), VK_CULL_MODE_BACK_BIT, VK_COMPARE_OP_GREATER, true, false);
-		m_shadowPipeline = createGraphicsPipeline(m_modelPipelineLayout, "shaders/shadow.vert.spv", std::filesystem::path(), VK_CULL_MODE_BACK_BIT, VK_COMPARE_OP_GREATER, true, false);
-	}
+		}), nullptr, &m_postprocessingPipelineLayout);
 
-	// Skybox Pipeline
-	{
+		// resolved frame, then every level of the bloom pyramid
 		vkCreateDescriptorSetLayout(m_device, ptr(VkDescriptorSetLayoutCreateInfo{
 			.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT,
-			.bindingCount = 1,
-			.pBindings = ptr(VkDescriptorSetLayoutBinding{
-				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-				.descriptorCount = 1,
-				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
-			})
-		}), nullptr, &m_skyboxSetLayout);
-
+			.bindingCount = 2,
+			.pBindings = ptr({
+				VkDescriptorSetLayoutBinding{
+					.binding = 0,
+					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+					.descriptorCount = 1,
+					.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+				},
+				VkDescriptorSetLayoutBinding{
+					.binding = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+					.descriptorCount = BLOOM_MIP_COUNT,
+					.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+				}
+			})
+		}), nullptr, &m_bloomSetLayout);
+
+		vkCreatePipelineLayout(m_device, ptr(VkPipelineLayoutCreateInfo{
+			.setLayoutCount = 1,
+			.pSetLayouts = &m_bloomSetLayout,
+			.pushConstantRangeCount = 1,
+			.pPushConstantRanges = ptr(VkPushConstantRange{
+				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+				.offset = 0,
+				.size = sizeof(BloomPushConstants)
+			})
+		}), nullptr, &m_bloomPipelineLayout);
+
+		// resolved frame and the top of the bloom pyramid, then the swapchain
+		vkCreateDescriptorSetLayout(m_device, ptr(VkDescriptorSetLayoutCreateInfo{
+			.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT,
+			.bindingCount = 3,
+			.pBindings = ptr({
+				VkDescriptorSetLayoutBinding{
+					.binding = 0,
+					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+					.descriptorCount = 1,
+					.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+				},
+				VkDescriptorSetLayoutBinding{
+					.binding = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+					.descriptorCount = 1,
+					.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+				},
+				VkDescriptorSetLayoutBinding{
+					.binding = 2,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+					.descriptorCount = 1,
+					.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+				}
+			})
+		}), nullptr, &m_tonemapSetLayout);
+
+		vkCreatePipelineLayout(m_device, ptr(VkPipelineLayoutCreateInfo{
+			.setLayoutCount = 1,
+			.pSetLayouts = &m_tonemapSetLayout,
+			.pushConstantRangeCount = 1,
+			.pPushConstantRanges = ptr(VkPushConstantRange{
+				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+				.offset = 0,
+				.size = sizeof(VkDeviceAddress)
+			})
+		}), nullptr, &m_tonemapPipelineLayout);
+
+		vkCreatePipelineLayout(m_device, ptr(VkPipelineLayoutCreateInfo{
+			.pushConstantRangeCount = 1,
+			.pPushConstantRanges = ptr(VkPushConstantRange{
+				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+				.offset = 0,
+				.size = sizeof(ClusterPushConstants)
+			})
+		}), nullptr, &m_clusterPipelineLayout);
+	}
+
+	// model pipeline layout
+	{
+		vkCreateDescriptorSetLayout(m_device, ptr(VkDescriptorSetLayoutCreateInfo{
+			.pNext = ptr(VkDescriptorSetLayoutBindingFlagsCreateInfo{
+				.bindingCount = 1,
+				.pBindingFlags = ptr<VkDescriptorBindingFlags>(VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT)
+			}),
+			.bindingCount = 1,
+			.pBindings = ptr(VkDescriptorSetLayoutBinding{
+				.binding = 0,
+				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.descriptorCount = m_maxSampledImageDescriptors,
+				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT
+			})
+		}), nullptr, &m_modelSetLayout);
+
+		vkCreateDescriptorSetLayout(m_device, ptr(VkDescriptorSetLayoutCreateInfo{
+			.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT,
+			.bindingCount = 4,
+			.pBindings = ptr({
+				VkDescriptorSetLayoutBinding{
+					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+					.descriptorCount = 1,
+					.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+				},
+				VkDescriptorSetLayoutBinding{
+					.binding = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+					.descriptorCount = 1,
+					.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+				},
+				VkDescriptorSetLayoutBinding{
+					.binding = 2,
+					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+					.descriptorCount = 1,
+					.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+				},
+				VkDescriptorSetLayoutBinding{
+					.binding = 3,
+					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+					.descriptorCount = 1,
+					.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+				}
+			})
+		}), nullptr, &m_modelPushDescriptorLayout);
+
+		vkCreatePipelineLayout(m_device, ptr(VkPipelineLayoutCreateInfo{
+			.setLayoutCount = 2,
+			.pSetLayouts = ptr({ m_modelSetLayout, m_modelPushDescriptorLayout }),
+			.pushConstantRangeCount = 1,
+			.pPushConstantRanges = ptr(VkPushConstantRange{
+				.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+				.offset = 0,
+				.size = sizeof(PushConstants),
+			})
+		}), nullptr, &m_modelPipelineLayout);
+
+		// the visibility buffer's material pass shades with the same textures from compute, plus the ids it reads and the target it writes
+		vkCreateDescriptorSetLayout(m_device, ptr(VkDescriptorSetLayoutCreateInfo{
+			.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT,
+			.bindingCount = 6,
+			.pBindings = ptr({
+				VkDescriptorSetLayoutBinding{
+					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+					.descriptorCount = 1,
+					.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+				},
+				VkDescriptorSetLayoutBinding{
+					.binding = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+					.descriptorCount = 1,
+					.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+				},
+				VkDescriptorSetLayoutBinding{
+					.binding = 2,
+					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+					.descriptorCount = 1,
+					.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+				},
+				VkDescriptorSetLayoutBinding{
+					.binding = 3,
+					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+					.descriptorCount = 1,
+					.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+				},
+				VkDescriptorSetLayoutBinding{
+					.binding = 4,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+					.descriptorCount = 1,
+					.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+				},
+				VkDescriptorSetLayoutBinding{
+					.binding = 5,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+					.descriptorCount = 1,
+					.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+				}
+			})
+		}), nullptr, &m_materialPushDescriptorLayout);
+
+		vkCreatePipelineLayout(m_device, ptr(VkPipelineLayoutCreateInfo{
+			.setLayoutCount = 2,
+			.pSetLayouts = ptr({ m_modelSetLayout, m_materialPushDescriptorLayout }),
+			.pushConstantRangeCount = 1,
+			.pPushConstantRanges = ptr(VkPushConstantRange{
+				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+				.offset = 0,
+				.size = sizeof(MaterialPassConstants),
+			})
+		}), nullptr, &m_materialPipelineLayout);
+	}
+
+	// skybox pipeline layout
+	{
+		vkCreateDescriptorSetLayout(m_device, ptr(VkDescriptorSetLayoutCreateInfo{
+			.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT,
+			.bindingCount = 1,
+			.pBindings = ptr(VkDescriptorSetLayoutBinding{
+				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.descriptorCount = 1,
+				.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+			})
+		}), nullptr, &m_skyboxSetLayout);
+
 		vkCreatePipelineLayout(m_device, ptr(VkPipelineLayoutCreateInfo{
 			.setLayoutCount = 1,
 			.pSetLayouts = &m_skyboxSetLayout,
@@ -479,8 +566,282 @@ Renderer::Renderer() {
 				.size = sizeof(glm::mat4),
 			})
 		}), nullptr, &m_skyboxPipelineLayout);
+	}
+
+	// pipelines (built on worker threads while the remaining setup runs)
+	m_pipelineRecipes = {
+		{ &m_mipPipeline, [this] { return createComputePipeline(m_twoImagePipelineLayout, "shaders/mip.comp.spv"); } },
+		{ &m_srgbMipPipeline, [this] { return createComputePipeline(m_twoImagePipelineLayout, "shaders/srgbmip.comp.spv"); } },
+		{ &m_cubePipeline, [this] { return createComputePipeline(m_oneTexOneImagePipelineLayout, "shaders/cube.comp.spv"); } },
+		{ &m_cubeMipPipeline, [this] { return createComputePipeline(m_twoImagePipelineLayout, "shaders/cubemip.comp.spv"); } },
+		{ &m_irradiancePipeline, [this] { return createComputePipeline(m_oneTexOneImagePipelineLayout, "shaders/irradiance.comp.spv"); } },
+		{ &m_radiancePipeline, [this] { return createComputePipeline(m_oneTexOneImagePipelineLayout, "shaders/radiance.comp.spv"); } },
+		{ &m_brdfIntegralPipeline, [this] { return createComputePipeline(m_oneImagePipelineLayout, "shaders/brdfintegral.comp.spv"); } },
+		// constant 0 is the texture bitfield, which oitresolve.comp doesn't use
+		{ &m_oitResolvePipeline, [this] { return createComputePipeline(m_oitResolvePipelineLayout, "shaders/oitresolve.comp.spv", std::array<u32, 3>{ 0, m_oitNodeCount, m_weightedBlendedOIT }); } },
+		{ &m_postprocessingPipeline, [this] { return createComputePipeline(m_postprocessingPipelineLayout, "shaders/postprocess.comp.spv"); } },
+		{ &m_bloomDownPipeline, [this] { return createComputePipeline(m_bloomPipelineLayout, "shaders/bloomdown.comp.spv"); } },
+		{ &m_bloomUpPipeline, [this] { return createComputePipeline(m_oneTexOneImagePipelineLayout, "shaders/bloomup.comp.spv"); } },
+		{ &m_tonemapPipeline, [this] { return createComputePipeline(m_tonemapPipelineLayout, "shaders/tonemap.comp.spv"); } },
+		{ &m_clusterPipeline, [this] { return createComputePipeline(m_clusterPipelineLayout, "shaders/cluster.comp.spv"); } },
+		{ &m_prepassPipeline, [this] { return createGraphicsPipeline(m_modelPipelineLayout, "shaders/prepass.vert.spv", std::filesystem::path(), VK_CULL_MODE_BACK_BIT, VK_COMPARE_OP_GREATER, true, {}); } },
+		{ &m_shadowPipeline, [this] { return createGraphicsPipeline(m_modelPipelineLayout, "shaders/shadow.vert.spv", std::filesystem::path(), VK_CULL_MODE_BACK_BIT, VK_COMPARE_OP_GREATER, true, {}); } },
+		{ &m_alphaTestPrepassPipeline, [this] { return createGraphicsPipeline(m_modelPipelineLayout, "shaders/prepass.vert.spv", "shaders/alphatest.frag.spv", VK_CULL_MODE_BACK_BIT, VK_COMPARE_OP_GREATER, true, {}); } },
+		{ &m_alphaTestShadowPipeline, [this] { return createGraphicsPipeline(m_modelPipelineLayout, "shaders/shadow.vert.spv", "shaders/alphatest.frag.spv", VK_CULL_MODE_BACK_BIT, VK_COMPARE_OP_GREATER, true, {}); } },
+		{ &m_skyboxPipeline, [this] { return createGraphicsPipeline(m_skyboxPipelineLayout, "shaders/skybox.vert.spv", "shaders/skybox.frag.spv", VK_CULL_MODE_NONE, VK_COMPARE_OP_EQUAL, false, { &m_colorFormat, 1 }); } }
+	};
+
+	std::vector<std::future<void>> pipelineJobs;
+	for(PipelineRecipe& recipe : m_pipelineRecipes) {
+		pipelineJobs.push_back(std::async(std::launch::async, [&recipe] { *recipe.pipeline = recipe.create(); }));
+	}
+
+	// per-frame data (vk::CommandPool, vk::CommandBuffer, vk::Semaphores, vk::Fence)
+	{
+		for(u8 i = 0; i < m_maxFramesInFlight; i++) {
+			vkCreateCommandPool(m_device, ptr(VkCommandPoolCreateInfo{
+				.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+				.queueFamilyIndex = m_graphicsQueueFamily
+			}), nullptr, &m_perFrameData[i].cmdPool);
+			vkAllocateCommandBuffers(m_device, ptr(VkCommandBufferAllocateInfo{
+				.commandPool = m_perFrameData[i].cmdPool,
+				.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+				.commandBufferCount = 1
+			}), &m_perFrameData[i].cmdBuffer);
+			vkAllocateCommandBuffers(m_device, ptr(VkCommandBufferAllocateInfo{
+				.commandPool = m_perFrameData[i].cmdPool,
+				.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+				.commandBufferCount = 1
+			}), &m_perFrameData[i].prepassCmdBuffer);
+			vkCreateCommandPool(m_device, ptr(VkCommandPoolCreateInfo{
+				.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+				.queueFamilyIndex = m_computeQueueFamily
+			}), nullptr, &m_perFrameData[i].computeCmdPool);
+			vkAllocateCommandBuffers(m_device, ptr(VkCommandBufferAllocateInfo{
+				.commandPool = m_perFrameData[i].computeCmdPool,
+				.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+				.commandBufferCount = 1
+			}), &m_perFrameData[i].computeCmdBuffer);
+			vkCreateSemaphore(m_device, ptr(VkSemaphoreCreateInfo{}), nullptr, &m_perFrameData[i].acquireSem);
+			vkCreateSemaphore(m_device, ptr(VkSemaphoreCreateInfo{}), nullptr, &m_perFrameData[i].presentSem);
+			vkCreateFence(m_device, ptr(VkFenceCreateInfo{ .flags = VK_FENCE_CREATE_SIGNALED_BIT }), nullptr, &m_perFrameData[i].fence);
+		}
+
+		// hand each frame from the graphics queue to the compute queue and back
+		for(VkSemaphore* timeline : { &m_sceneTimeline, &m_postTimeline }) {
+			vkCreateSemaphore(m_device, ptr(VkSemaphoreCreateInfo{
+				.pNext = ptr(VkSemaphoreTypeCreateInfo{
+					.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+					.initialValue = m_frameNumber
+				})
+			}), nullptr, timeline);
+		}
+
+		if(m_gpuTimingSupported) {
+			vkCreateQueryPool(m_device, ptr(VkQueryPoolCreateInfo{
+				.queryType = VK_QUERY_TYPE_TIMESTAMP,
+				.queryCount = m_timestampsPerFrame * m_maxFramesInFlight
+			}), nullptr, &m_timestampPool);
+		}
+	}
+
+	// VkSurface and VkSwapchain
+	{
+		glfwCreateWindowSurface(m_instance, m_window, nullptr, &m_surface);
+		vkGetPhysicalDeviceSurfaceFormatsKHR(m_physicalDevice, m_surface, ptr(1u), &m_surfaceFormat);
+
+		u32 numPresentModes;
+		vkGetPhysicalDeviceSurfacePresentModesKHR(m_physicalDevice, m_surface, &numPresentModes, nullptr);
+		m_presentModes.resize(numPresentModes);
+		vkGetPhysicalDeviceSurfacePresentModesKHR(m_physicalDevice, m_surface, &numPresentModes, m_presentModes.data());
+
+		// shared present modes need a different image usage, so only the four regular ones are offered
+		std::erase_if(m_presentModes, [](VkPresentModeKHR mode) { return mode > VK_PRESENT_MODE_FIFO_RELAXED_KHR; });
+
+		createSwapchain();
+	}
+
+	// transfer objects
+	{
+		vkCreateCommandPool(m_device, ptr(VkCommandPoolCreateInfo{
+			.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+			.queueFamilyIndex = m_transferQueueFamily
+		}), nullptr, &m_transferPool);
+		vkAllocateCommandBuffers(m_device, ptr(VkCommandBufferAllocateInfo{
+			.commandPool = m_transferPool,
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1
+		}), &m_transferCmd);
+
+		vkCreateCommandPool(m_device, ptr(VkCommandPoolCreateInfo{
+			.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+			.queueFamilyIndex = m_computeQueueFamily
+		}), nullptr, &m_computePool);
+		vkAllocateCommandBuffers(m_device, ptr(VkCommandBufferAllocateInfo{
+			.commandPool = m_computePool,
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1
+		}), &m_computeCmd);
+
+		vkCreateSemaphore(m_device, ptr(VkSemaphoreCreateInfo{}), nullptr, &m_transferToComputeSem);
+	}
+
+	// global samplers
+	{
+		vkCreateSampler(m_device, ptr(VkSamplerCreateInfo{
+			.magFilter = VK_FILTER_LINEAR,
+			.minFilter = VK_FILTER_LINEAR,
+			.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+			.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.anisotropyEnable = true,
+			.maxAnisotropy = 16,
+			.maxLod = VK_LOD_CLAMP_NONE
+		}), nullptr, &m_skyboxSampler);
+
+		vkCreateSampler(m_device, ptr(VkSamplerCreateInfo{
+			.magFilter = VK_FILTER_LINEAR,
+			.minFilter = VK_FILTER_LINEAR,
+			.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.compareEnable = true,
+			.compareOp = VK_COMPARE_OP_GREATER
+		}), nullptr, &m_shadowSampler);
+
+		vkCreateSampler(m_device, ptr(VkSamplerCreateInfo{
+			.magFilter = VK_FILTER_LINEAR,
+			.minFilter = VK_FILTER_LINEAR,
+			.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE
+		}), nullptr, &m_postprocessingSampler);
+	}
+
+	// Allocate Shadow Map
+	{
+		m_shadowMap = createImage(m_shadowMapSize, m_shadowMapSize, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+		
+		u32 poissonDiskBufferSize = m_poissonDiskWindowSize * m_poissonDiskWindowSize * m_poissonDiskFilterSize * m_poissonDiskFilterSize * sizeof(glm::vec2);
+
+		std::vector<glm::vec2> samples;
+		samples.reserve(poissonDiskBufferSize / sizeof(glm::vec2));
+
+		std::default_random_engine generator;
+		std::uniform_real_distribution<f32> distribution(-0.5f, 0.5f);
+
+		for(i32 v = m_poissonDiskFilterSize - 1; v >= 0; v--) {
+			for(i32 u = 0; u < m_poissonDiskFilterSize; u++) {
+				for(i32 i = 0; i < m_poissonDiskWindowSize * m_poissonDiskWindowSize; i++) {
+					f32 x = (u + 0.5f + distribution(generator)) / m_poissonDiskFilterSize;
+					f32 y = (v + 0.5f + distribution(generator)) / m_poissonDiskFilterSize;
+					
+					glm::vec2 sample(std::sqrtf(y) * std::cosf(2.0f * std::numbers::pi_v<f32> * x), std::sqrtf(y) * std::sinf(2.0f * std::numbers::pi_v<f32> * x));
+					samples.push_back(sample);
+				}
+			}
+		}
 
-		m_skyboxPipeline = createGraphicsPipeline(m_skyboxPipelineLayout, "shaders/skybox.vert.spv", "shaders/skybox.frag.spv", VK_CULL_MODE_NONE, VK_COMPARE_OP_EQUAL, false, true);
+		std::vector<Buffer> stagingBuffers;
+		vkBeginCommandBuffer(m_transferCmd, ptr(VkCommandBufferBeginInfo{ .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT }));
+		m_poissonDiskBuffer = createUploadBuffer(VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, { std::as_bytes(std::span(samples)) }, stagingBuffers);
+		vkEndCommandBuffer(m_transferCmd);
+
+		// nothing to submit when the samples were written in place
+		if(!stagingBuffers.empty()) {
+			vkQueueSubmit2(m_transferQueue, 1, ptr(VkSubmitInfo2{
+				.commandBufferInfoCount = 1,
+				.pCommandBufferInfos = ptr(VkCommandBufferSubmitInfo{.commandBuffer = m_transferCmd })
+			}), nullptr);
+
+			vkQueueWaitIdle(m_transferQueue);
+		}
+		vkResetCommandPool(m_device, m_transferPool, 0);
+		
+		for(Buffer i : stagingBuffers) {
+			destroyBuffer(i);
+		}
+	}
+
+	// Allocate Exposure Buffer (histogram bins and workgroup counter have to start out cleared)
+	{
+		m_exposureBuffer = createBuffer(sizeof(ExposureState), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		vkBeginCommandBuffer(m_transferCmd, ptr(VkCommandBufferBeginInfo{ .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT }));
+		vkCmdFillBuffer(m_transferCmd, m_exposureBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+		vkEndCommandBuffer(m_transferCmd);
+
+		vkQueueSubmit2(m_transferQueue, 1, ptr(VkSubmitInfo2{
+			.commandBufferInfoCount = 1,
+			.pCommandBufferInfos = ptr(VkCommandBufferSubmitInfo{.commandBuffer = m_transferCmd })
+		}), nullptr);
+
+		vkQueueWaitIdle(m_transferQueue);
+		vkResetCommandPool(m_device, m_transferPool, 0);
+	}
+
+	// Allocate Cluster Buffer (cluster.comp rebuilds its contents every frame)
+	{
+		m_clusterBuffer = createBuffer(sizeof(ClusterBufferHeader) + CLUSTER_COUNT * sizeof(Cluster), VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+
+	// wait for pipelines
+	{
+		for(std::future<void>& job : pipelineJobs) {
+			job.wait();
+		}
+	}
+
+	// generate brdf integral tex
+	{
+		m_brdfIntegralTex = createImage(m_brdfIntegralLUTSize, m_brdfIntegralLUTSize, VK_FORMAT_R16G16_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+		vkBeginCommandBuffer(m_computeCmd, ptr(VkCommandBufferBeginInfo{ .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT }));
+		
+		vkCmdPipelineBarrier2(m_computeCmd, ptr(VkDependencyInfo{
+			.imageMemoryBarrierCount = 1,
+			.pImageMemoryBarriers = ptr(VkImageMemoryBarrier2{
+				.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+				.dstAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
+				.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+				.image = m_brdfIntegralTex.image,
+				.subresourceRange = colorSubresourceRange()
+			})
+		}));
+
+		vkCmdBindPipeline(m_computeCmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_brdfIntegralPipeline);
+
+		vkCmdPushDescriptorSet(m_computeCmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_oneImagePipelineLayout, 0, 1, ptr(VkWriteDescriptorSet{
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.pImageInfo = ptr(VkDescriptorImageInfo{
+				.imageView = m_brdfIntegralTex.view,
+				.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+			})
+		}));
+
+		vkCmdDispatch(m_computeCmd, (m_brdfIntegralLUTSize + 7) / 8, (m_brdfIntegralLUTSize + 7) / 8, 1);
+
+		vkCmdPipelineBarrier2(m_computeCmd, ptr(VkDependencyInfo{
+			.imageMemoryBarrierCount = 1,
+			.pImageMemoryBarriers = ptr(VkImageMemoryBarrier2{
+				.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+				.srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
+				.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+				.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				.image = m_brdfIntegralTex.image,
+				.subresourceRange = colorSubresourceRange()
+			})
+		}));
+
+		vkEndCommandBuffer(m_computeCmd);
+
+		vkQueueSubmit2(m_computeQueue, 1, ptr(VkSubmitInfo2{
+			.commandBufferInfoCount = 1,
+			.pCommandBufferInfos = ptr(VkCommandBufferSubmitInfo{.commandBuffer = m_computeCmd })
+		}), nullptr);
+
+		vkQueueWaitIdle(m_computeQueue);
+		vkResetCommandPool(m_device, m_computePool, 0);
 	}
 
 	// Load Model
@@ -516,23 +877,47 @@ Renderer::Renderer() {
 			NFD_FreePathU8(outPath);
 		}
 	}
+
+#ifdef SHADER_HOT_RELOAD
+	// shader hot reload
+	{
+		m_shaderWatcher = std::jthread([this](std::stop_token stop) {
+			watchShaders(stop);
+		});
+	}
+#endif
 }
 
 Renderer::~Renderer() {
+#ifdef SHADER_HOT_RELOAD
+	m_shaderWatcher.request_stop();
+	m_shaderWatcher.join();
+	swapReloadedPipelines();
+#endif
+
 	vkDeviceWaitIdle(m_device);
 
-	for(u8 i = 0; i < m_framesInFlight; i++) {
+	for(u8 i = 0; i < m_maxFramesInFlight; i++) {
 		vkDestroyCommandPool(m_device, m_perFrameData[i].cmdPool, nullptr);
+		vkDestroyCommandPool(m_device, m_perFrameData[i].computeCmdPool, nullptr);
 		vkDestroySemaphore(m_device, m_perFrameData[i].acquireSem, nullptr);
 		vkDestroySemaphore(m_device, m_perFrameData[i].presentSem, nullptr);
 		vkDestroyFence(m_device, m_perFrameData[i].fence, nullptr);
 	}
+	vkDestroySemaphore(m_device, m_sceneTimeline, nullptr);
+	vkDestroySemaphore(m_device, m_postTimeline, nullptr);
+	vkDestroyQueryPool(m_device, m_timestampPool, nullptr);
 
 	vkDestroyCommandPool(m_device, m_transferPool, nullptr);
 	vkDestroyCommandPool(m_device, m_computePool, nullptr);
 	vkDestroySemaphore(m_device, m_transferToComputeSem, nullptr);
 
+	vkDestroyPipeline(m_device, m_oitResolvePipeline, nullptr);
 	vkDestroyPipeline(m_device, m_postprocessingPipeline, nullptr);
+	vkDestroyPipeline(m_device, m_bloomDownPipeline, nullptr);
+	vkDestroyPipeline(m_device, m_bloomUpPipeline, nullptr);
+	vkDestroyPipeline(m_device, m_tonemapPipeline, nullptr);
+	vkDestroyPipeline(m_device, m_clusterPipeline, nullptr);
 	vkDestroyPipeline(m_device, m_brdfIntegralPipeline, nullptr);
 	vkDestroyPipeline(m_device, m_radiancePipeline, nullptr);
 	vkDestroyPipeline(m_device, m_irradiancePipeline, nullptr);
@@ -541,7 +926,15 @@ Renderer::~Renderer() {
 	vkDestroyPipeline(m_device, m_mipPipeline, nullptr);
 	vkDestroyPipeline(m_device, m_srgbMipPipeline, nullptr);
 
+	vkDestroyPipelineLayout(m_device, m_tonemapPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(m_device, m_tonemapSetLayout, nullptr);
+	vkDestroyPipelineLayout(m_device, m_bloomPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(m_device, m_bloomSetLayout, nullptr);
 	vkDestroyPipelineLayout(m_device, m_postprocessingPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(m_device, m_clusterPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(m_device, m_postprocessingSetLayout, nullptr);
+	vkDestroyPipelineLayout(m_device, m_oitResolvePipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(m_device, m_oitResolveSetLayout, nullptr);
 	
 	vkDestroyPipelineLayout(m_device, m_oneTexOneImagePipelineLayout, nullptr);
 	vkDestroyDescriptorSetLayout(m_device, m_oneTexOneImageSetLayout, nullptr);
@@ -558,23 +951,38 @@ Renderer::~Renderer() {
 
 	vkDestroyPipeline(m_device, m_shadowPipeline, nullptr);
 	vkDestroyPipeline(m_device, m_prepassPipeline, nullptr);
-	vkDestroyPipeline(m_device, m_blendPipeline, nullptr);
-	vkDestroyPipeline(m_device, m_opaquePipeline, nullptr);
+	vkDestroyPipeline(m_device, m_alphaTestPrepassPipeline, nullptr);
+	vkDestroyPipeline(m_device, m_alphaTestShadowPipeline, nullptr);
 	vkDestroyPipelineLayout(m_device, m_modelPipelineLayout, nullptr);
 	vkDestroyDescriptorSetLayout(m_device, m_modelSetLayout, nullptr);
 	vkDestroyDescriptorSetLayout(m_device, m_modelPushDescriptorLayout, nullptr);
+	vkDestroyPipelineLayout(m_device, m_materialPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(m_device, m_materialPushDescriptorLayout, nullptr);
 
 	vkDestroySampler(m_device, m_shadowSampler, nullptr);
 	vkDestroySampler(m_device, m_skyboxSampler, nullptr);
+	vkDestroySampler(m_device, m_postprocessingSampler, nullptr);
 	destroySkybox(m_skybox);
 	destroyModel(m_model);
 
 	destroyImage(m_shadowMap);
 	destroyImage(m_brdfIntegralTex);
 	destroyImage(m_colorTarget);
-	destroyImage(m_depthTarget);
-	destroyBuffer(m_oitBuffer);
+	for(Image depth : m_depthTargets) {
+		destroyImage(depth);
+	}
+	destroyImage(m_visibilityTarget);
+	for(Image history : m_historyTargets) {
+		destroyImage(history);
+	}
+	for(VkImageView view : m_bloomMipViews) {
+		vkDestroyImageView(m_device, view, nullptr);
+	}
+	destroyImage(m_bloomTarget);
+	destroyOITResources();
 	destroyBuffer(m_poissonDiskBuffer);
+	destroyBuffer(m_clusterBuffer);
+	destroyBuffer(m_exposureBuffer);
 	
 	for(VkImageView view : m_swapchainImageViews) {
 		vkDestroyImageView(m_device, view, nullptr);
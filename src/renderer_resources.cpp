@@ -1,24 +1,41 @@
 #include "renderer.hpp"
 #include <tbrs/vk_util.hpp>
 #include <../shared/oitnode.h>
+#include <../shared/material.h>
+#include <../shared/bloom.h>
+#include <algorithm>
+#include <array>
 
 void Renderer::createSwapchain() {
 	VkSwapchainKHR oldSwapchain = m_swapchain;
 
+	VkSurfaceCapabilitiesKHR surfaceCaps;
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_physicalDevice, m_surface, &surfaceCaps);
+
+	if(std::ranges::find(m_presentModes, m_presentMode) == m_presentModes.end()) {
+		m_presentMode = VK_PRESENT_MODE_FIFO_KHR;
+	}
+
+	// one image past the minimum so acquisition doesn't stall on the presentation engine, unless we're trading throughput for latency
+	u32 minImageCount = m_latencyLimiter ? surfaceCaps.minImageCount : surfaceCaps.minImageCount + 1;
+	if(surfaceCaps.maxImageCount != 0) {
+		minImageCount = std::min(minImageCount, surfaceCaps.maxImageCount);
+	}
+
 	vkCreateSwapchainKHR(m_device, ptr(VkSwapchainCreateInfoKHR{
 		.surface = m_surface,
-		.minImageCount = 3,
+		.minImageCount = minImageCount,
 		.imageFormat = m_surfaceFormat.format,
 		.imageColorSpace = m_surfaceFormat.colorSpace,
 		.imageExtent = { static_cast<u32>(m_width), static_cast<u32>(m_height) },
 		.imageArrayLayers = 1,
 		.imageUsage = VK_IMAGE_USAGE_STORAGE_BIT,
-		.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
-		.queueFamilyIndexCount = 1,
-		.pQueueFamilyIndices = ptr(m_graphicsQueueFamily),
+		.imageSharingMode = VK_SHARING_MODE_CONCURRENT, // written by the compute queue, presented from the graphics queue
+		.queueFamilyIndexCount = 2,
+		.pQueueFamilyIndices = ptr({ m_graphicsQueueFamily, m_computeQueueFamily }),
 		.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
 		.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-		.presentMode = VK_PRESENT_MODE_FIFO_KHR,
+		.presentMode = m_presentMode,
 		.clipped = true,
 		.oldSwapchain = oldSwapchain
 	}), nullptr, &m_swapchain);
@@ -30,6 +47,10 @@ void Renderer::createSwapchain() {
 	m_swapchainImages.resize(numSwapchainImages);
 	vkGetSwapchainImagesKHR(m_device, m_swapchain, &numSwapchainImages, m_swapchainImages.data());
 
+	// present ids are per-swapchain, so numbering restarts with the new one
+	m_presentId = 0;
+	m_framesInFlight = m_latencyLimiter ? 1 : static_cast<u8>(std::clamp<u32>(numSwapchainImages - 1, 1, m_maxFramesInFlight));
+
 	for(VkImage img : m_swapchainImages) {
 		VkImageView cur;
 		vkCreateImageView(m_device, ptr(VkImageViewCreateInfo{
@@ -41,21 +62,33 @@ void Renderer::createSwapchain() {
 		m_swapchainImageViews.push_back(cur);
 	}
 
-	m_oitBuffer = createBuffer(m_width * m_height * 4 * sizeof(OITNode), VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	m_colorTarget = createImage(m_width, m_height, m_colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
-	m_depthTarget = createImage(m_width, m_height, m_depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+	// allocated for the largest render scale so changing it never reallocates, smaller ones only render into part of them
+	m_colorTarget = createImage(m_width, m_height, m_colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+	for(Image& depth : m_depthTargets) {
+		depth = createImage(m_width, m_height, m_depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+	}
+	if(m_visibilityBufferSupported) {
+		m_visibilityTarget = createImage(m_width, m_height, m_visibilityFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
+	}
+	for(Image& history : m_historyTargets) {
+		history = createImage(m_width, m_height, m_colorFormat, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+	}
+	m_historyValid = false;
 
-	vkResetCommandPool(m_device, m_perFrameData->cmdPool, 0);
-	vkBeginCommandBuffer(m_perFrameData->cmdBuffer, ptr(VkCommandBufferBeginInfo{ .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT }));
-	vkCmdFillBuffer(m_perFrameData->cmdBuffer, m_oitBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
-	vkEndCommandBuffer(m_perFrameData->cmdBuffer);
-	
-	vkQueueSubmit2(m_graphicsQueue, 1, ptr(VkSubmitInfo2{
-		.commandBufferInfoCount = 1,
-		.pCommandBufferInfos = ptr(VkCommandBufferSubmitInfo{ .commandBuffer = m_perFrameData->cmdBuffer })
-	}), nullptr);
-	
-	vkQueueWaitIdle(m_graphicsQueue);
+	i32 bloomWidth = std::max(m_width / 2, 1);
+	i32 bloomHeight = std::max(m_height / 2, 1);
+	m_bloomMipCount = std::min<u32>(BLOOM_MIP_COUNT, std::floor(std::log2(std::max(bloomWidth, bloomHeight))) + 1);
+	m_bloomTarget = createImage(bloomWidth, bloomHeight, m_colorFormat, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, m_bloomMipCount);
+	for(u32 i = 0; i < m_bloomMipCount; i++) {
+		VkImageView mipView;
+		vkCreateImageView(m_device, ptr(VkImageViewCreateInfo{
+			.image = m_bloomTarget.image,
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = m_colorFormat,
+			.subresourceRange = VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 }
+		}), nullptr, &mipView);
+		m_bloomMipViews.push_back(mipView);
+	}
 }
 
 void Renderer::recreateSwapchain() {
@@ -66,10 +99,22 @@ void Renderer::recreateSwapchain() {
 	}
 
 	vkDeviceWaitIdle(m_device);
+	m_frameGraph.forgetResources();
 
-	destroyBuffer(m_oitBuffer);
+	destroyOITResources();
 	destroyImage(m_colorTarget);
-	destroyImage(m_depthTarget);
+	for(Image depth : m_depthTargets) {
+		destroyImage(depth);
+	}
+	destroyImage(m_visibilityTarget);
+	for(Image history : m_historyTargets) {
+		destroyImage(history);
+	}
+	for(VkImageView view : m_bloomMipViews) {
+		vkDestroyImageView(m_device, view, nullptr);
+	}
+	m_bloomMipViews.resize(0);
+	destroyImage(m_bloomTarget);
 	for(VkImageView view : m_swapchainImageViews) {
 		vkDestroyImageView(m_device, view, nullptr);
 	}
@@ -165,15 +210,113 @@ Renderer::Buffer Renderer::createBuffer(u64 size, VkBufferUsageFlags usage, VkMe
 	return buffer;
 }
 
+// a device local buffer holding the concatenation of data, for the GPU to read only
+// it's written in place when the device has host visible device local memory to spare, which skips the staging copy entirely on UMA devices and with resizable BAR
+// otherwise the data goes through a staging buffer, copied on m_transferCmd (which has to be recording) and appended to stagingBuffers, to be destroyed once the copy is done
+Renderer::Buffer Renderer::createUploadBuffer(VkBufferUsageFlags usage, std::initializer_list<std::span<const std::byte>> data, std::vector<Buffer>& stagingBuffers) {
+	u64 size = 0;
+	for(std::span<const std::byte> part : data) {
+		size += part.size();
+	}
+
+	const b8 direct = size <= getDirectUploadBudget();
+	Buffer buffer = direct
+		? createBuffer(size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+		: createBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	Buffer staging = direct ? buffer : createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	u64 offset = 0;
+	for(std::span<const std::byte> part : data) {
+		memcpy(reinterpret_cast<char*>(staging.hostPtr) + offset, part.data(), part.size());
+		offset += part.size();
+	}
+
+	if(direct) {
+		// coherent, so the writes are visible to the next submission without a flush, and the mapping can go to make room for the device address
+		vkUnmapMemory(m_device, buffer.memory);
+		buffer.devicePtr = (usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) ? vkGetBufferDeviceAddress(m_device, ptr(VkBufferDeviceAddressInfo{ .buffer = buffer.buffer })) : 0;
+	}
+	else {
+		vkCmdCopyBuffer(m_transferCmd, staging.buffer, buffer.buffer, 1, ptr(VkBufferCopy{ .size = size }));
+		stagingBuffers.push_back(staging);
+	}
+
+	return buffer;
+}
+
 void Renderer::destroyBuffer(Buffer buffer) {
 	vkDestroyBuffer(m_device, buffer.buffer, nullptr);
 	vkFreeMemory(m_device, buffer.memory, nullptr);
 }
 
-VkPipeline Renderer::createComputePipeline(VkPipelineLayout layout, std::filesystem::path shaderPath) {
+// replaces the OIT buffer with a zeroed one holding m_oitNodeCount nodes for each of numPixels pixels, followed by a tile mask big enough for the whole framebuffer
+// the weighted blended backend only uses the header and tile mask, its per-pixel state lives in two framebuffer sized targets instead
+void Renderer::createOITResources(u64 numPixels) {
+	vkDeviceWaitIdle(m_device);
+	m_frameGraph.forgetResources();
+	destroyOITResources();
+
+	const u64 numTiles = static_cast<u64>((m_width + OIT_TILE_SIZE - 1) / OIT_TILE_SIZE) * ((m_height + OIT_TILE_SIZE - 1) / OIT_TILE_SIZE);
+	m_oitTileMaskOffset = sizeof(OITBufferHeader) + (m_weightedBlendedOIT ? 0 : numPixels * m_oitNodeCount * sizeof(OITNode));
+	m_oitTileMaskSize = (numTiles + 31) / 32 * sizeof(u32);
+
+	m_oitBuffer = createBuffer(m_oitTileMaskOffset + m_oitTileMaskSize, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	m_oitBufferPixels = m_weightedBlendedOIT ? static_cast<u64>(m_width) * m_height : numPixels;
+
+	if(m_weightedBlendedOIT) {
+		m_oitAccumTarget = createImage(m_width, m_height, m_colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
+		m_oitRevealageTarget = createImage(m_width, m_height, m_colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
+	}
+
+	vkResetCommandPool(m_device, m_perFrameData->cmdPool, 0);
+	vkBeginCommandBuffer(m_perFrameData->cmdBuffer, ptr(VkCommandBufferBeginInfo{ .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT }));
+	vkCmdFillBuffer(m_perFrameData->cmdBuffer, m_oitBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+	vkEndCommandBuffer(m_perFrameData->cmdBuffer);
+	
+	vkQueueSubmit2(m_graphicsQueue, 1, ptr(VkSubmitInfo2{
+		.commandBufferInfoCount = 1,
+		.pCommandBufferInfos = ptr(VkCommandBufferSubmitInfo{ .commandBuffer = m_perFrameData->cmdBuffer })
+	}), nullptr);
+	
+	vkQueueWaitIdle(m_graphicsQueue);
+}
+
+void Renderer::destroyOITResources() {
+	destroyBuffer(m_oitBuffer);
+	destroyImage(m_oitAccumTarget);
+	destroyImage(m_oitRevealageTarget);
+	m_oitBuffer = {};
+	m_oitAccumTarget = {};
+	m_oitRevealageTarget = {};
+	m_oitBufferPixels = 0;
+}
+
+// the node count and backend are baked into the blend and OIT resolve pipelines, so changing either means new pipelines and new resources
+void Renderer::rebuildOITPipelines() {
+	vkDeviceWaitIdle(m_device);
+
+	rebuildPipeline(&m_oitResolvePipeline);
+	for(MaterialPermutation& permutation : m_model.blendPermutations) {
+		rebuildPipeline(&permutation.pipeline);
+	}
+
+	destroyOITResources();
+	m_oitDirty = false;
+}
+
+static std::vector<VkSpecializationMapEntry> getSpecializationMapEntries(std::span<const u32> specConstants) {
+	std::vector<VkSpecializationMapEntry> ret;
+	for(u32 i = 0; i < specConstants.size(); i++) {
+		ret.push_back(VkSpecializationMapEntry{ i, static_cast<u32>(i * sizeof(u32)), sizeof(u32) });
+	}
+	return ret;
+}
+
+VkPipeline Renderer::createComputePipeline(VkPipelineLayout layout, std::filesystem::path shaderPath, std::span<const u32> specConstants) {
 	VkPipeline ret;
 
-	std::vector<u32> shaderSrc = getShaderSource(shaderPath);
+	ShaderSource shaderSrc = getShaderSource(shaderPath);
+	std::vector<VkSpecializationMapEntry> specEntries = getSpecializationMapEntries(specConstants);
 
 	vkCreateComputePipelines(m_device, nullptr, 1, ptr(VkComputePipelineCreateInfo{
 		.stage = {
@@ -182,24 +325,42 @@ VkPipeline Renderer::createComputePipeline(VkPipelineLayout layout, std::filesys
 				.pCode = shaderSrc.data()
 			}),
 			.stage = VK_SHADER_STAGE_COMPUTE_BIT,
-			.pName = "main"
+			.pName = "main",
+			.pSpecializationInfo = ptr(VkSpecializationInfo{
+				.mapEntryCount = static_cast<u32>(specEntries.size()),
+				.pMapEntries = specEntries.data(),
+				.dataSize = specConstants.size_bytes(),
+				.pData = specConstants.data()
+			})
 		},
 		.layout = layout
 	}), nullptr, &ret);
 
+#ifdef SHADER_HOT_RELOAD
+	std::scoped_lock lock(m_hotReloadMutex);
+	m_pipelineShaders[ret] = { shaderPath };
+#endif
+
 	return ret;
 }
 
-VkPipeline Renderer::createGraphicsPipeline(VkPipelineLayout layout, std::filesystem::path vsPath, std::filesystem::path fsPath, VkCullModeFlagBits cullMode, VkCompareOp compareOp, bool depthWrite, bool hasColorAttachment) {
+VkPipeline Renderer::createGraphicsPipeline(VkPipelineLayout layout, std::filesystem::path vsPath, std::filesystem::path fsPath, VkCullModeFlagBits cullMode, VkCompareOp compareOp, bool depthWrite, std::span<const VkFormat> colorFormats, std::span<const VkPipelineColorBlendAttachmentState> blendStates, std::span<const u32> fsSpecConstants) {
 	VkPipeline ret;
 
-	std::vector<u32> vsSrc = getShaderSource(vsPath);
-	std::vector<u32> fsSrc = fsPath.empty() ? std::vector<u32>{} : getShaderSource(fsPath);
+	ShaderSource vsSrc = getShaderSource(vsPath);
+	ShaderSource fsSrc = fsPath.empty() ? ShaderSource{} : getShaderSource(fsPath);
+	std::vector<VkSpecializationMapEntry> fsSpecEntries = getSpecializationMapEntries(fsSpecConstants);
+
+	// attachments without an explicit blend state just overwrite
+	std::vector<VkPipelineColorBlendAttachmentState> attachments(colorFormats.size(), VkPipelineColorBlendAttachmentState{ .colorWriteMask = colorComponentAll() });
+	if(!blendStates.empty()) {
+		attachments.assign(blendStates.begin(), blendStates.end());
+	}
 
 	vkCreateGraphicsPipelines(m_device, nullptr, 1, ptr(VkGraphicsPipelineCreateInfo{
 		.pNext = ptr(VkPipelineRenderingCreateInfo{
-			.colorAttachmentCount = hasColorAttachment ? 1u : 0u,
-			.pColorAttachmentFormats = &m_colorFormat,
+			.colorAttachmentCount = static_cast<u32>(colorFormats.size()),
+			.pColorAttachmentFormats = colorFormats.data(),
 			.depthAttachmentFormat = m_depthFormat
 		}),
 		.stageCount = fsPath.empty() ? 1u : 2u,
@@ -218,7 +379,13 @@ VkPipeline Renderer::createGraphicsPipeline(VkPipelineLayout layout, std::filesy
 					.pCode = fsSrc.data()
 				}),
 				.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-				.pName = "main"
+				.pName = "main",
+				.pSpecializationInfo = ptr(VkSpecializationInfo{
+					.mapEntryCount = static_cast<u32>(fsSpecEntries.size()),
+					.pMapEntries = fsSpecEntries.data(),
+					.dataSize = fsSpecConstants.size_bytes(),
+					.pData = fsSpecConstants.data()
+				})
 			},
 		}),
 		.pVertexInputState = ptr(VkPipelineVertexInputStateCreateInfo{}),
@@ -227,10 +394,79 @@ VkPipeline Renderer::createGraphicsPipeline(VkPipelineLayout layout, std::filesy
 		.pRasterizationState = ptr(VkPipelineRasterizationStateCreateInfo{.cullMode = static_cast<VkCullModeFlags>(cullMode), .lineWidth = 1.0f }),
 		.pMultisampleState = ptr(VkPipelineMultisampleStateCreateInfo{.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT }),
 		.pDepthStencilState = ptr(VkPipelineDepthStencilStateCreateInfo{.depthTestEnable = true, .depthWriteEnable = depthWrite, .depthCompareOp = compareOp }),
-		.pColorBlendState = ptr(VkPipelineColorBlendStateCreateInfo{.attachmentCount = 1, .pAttachments = ptr(VkPipelineColorBlendAttachmentState{.colorWriteMask = colorComponentAll() })}),
+		.pColorBlendState = ptr(VkPipelineColorBlendStateCreateInfo{.attachmentCount = static_cast<u32>(attachments.size()), .pAttachments = attachments.data() }),
 		.pDynamicState = ptr(VkPipelineDynamicStateCreateInfo{.dynamicStateCount = 2, .pDynamicStates = ptr({ VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR }) }),
 		.layout = layout
 	}), nullptr, &ret);
 
+#ifdef SHADER_HOT_RELOAD
+	std::scoped_lock lock(m_hotReloadMutex);
+	m_pipelineShaders[ret] = fsPath.empty() ? std::vector{ vsPath } : std::vector{ vsPath, fsPath };
+#endif
+
 	return ret;
+}
+
+VkPipeline Renderer::createPermutationPipeline(const MaterialPermutation& permutation, b8 blend) {
+	if(blend && m_weightedBlendedOIT) {
+		// accumulation is additive, revealage is multiplied by 1 - alpha
+		return createGraphicsPipeline(m_modelPipelineLayout, "shaders/model.vert.spv", "shaders/wboit.frag.spv", VK_CULL_MODE_NONE, VK_COMPARE_OP_GREATER, false, std::array{ m_colorFormat, m_colorFormat }, std::array{
+			VkPipelineColorBlendAttachmentState{
+				.blendEnable = true,
+				.srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
+				.dstColorBlendFactor = VK_BLEND_FACTOR_ONE,
+				.colorBlendOp = VK_BLEND_OP_ADD,
+				.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+				.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+				.alphaBlendOp = VK_BLEND_OP_ADD,
+				.colorWriteMask = colorComponentAll()
+			},
+			VkPipelineColorBlendAttachmentState{
+				.blendEnable = true,
+				.srcColorBlendFactor = VK_BLEND_FACTOR_ZERO,
+				.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR,
+				.colorBlendOp = VK_BLEND_OP_ADD,
+				.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+				.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+				.alphaBlendOp = VK_BLEND_OP_ADD,
+				.colorWriteMask = colorComponentAll()
+			}
+		}, { &permutation.texBitfield, 1 });
+	}
+	if(blend) {
+		return createGraphicsPipeline(m_modelPipelineLayout, "shaders/model.vert.spv", "shaders/blend.frag.spv", VK_CULL_MODE_NONE, VK_COMPARE_OP_GREATER, false, {}, {}, std::array{ permutation.texBitfield, m_oitNodeCount });
+	}
+	return createGraphicsPipeline(m_modelPipelineLayout, "shaders/model.vert.spv", "shaders/opaque.frag.spv", VK_CULL_MODE_BACK_BIT, VK_COMPARE_OP_EQUAL, false, { &m_colorFormat, 1 }, {}, { &permutation.texBitfield, 1 });
+}
+
+// the visibility prepass packs ids with drawBits bits of draw index and the material pass unpacks them the same way
+VkPipeline Renderer::createVisibilityPipeline(u32 drawBits, b8 material) {
+	if(material) {
+		// every opaque material goes through the one dispatch, so the texture bitfield stays dynamic
+		return createComputePipeline(m_materialPipelineLayout, "shaders/material.comp.spv", std::array{ DYNAMIC_TEX_BITFIELD, drawBits });
+	}
+	// constant 0 is the texture bitfield, which visibility.frag doesn't use
+	return createGraphicsPipeline(m_modelPipelineLayout, "shaders/visibility.vert.spv", "shaders/visibility.frag.spv", VK_CULL_MODE_BACK_BIT, VK_COMPARE_OP_GREATER, true, { &m_visibilityFormat, 1 }, {}, std::array{ 0u, drawBits });
+}
+
+// recreates a pipeline from its recipe, the caller makes sure the old one is no longer in use
+void Renderer::rebuildPipeline(VkPipeline* pipeline) {
+#ifdef SHADER_HOT_RELOAD
+	std::scoped_lock recipesLock(m_pipelineRecipesMutex);
+#endif
+	auto recipe = std::ranges::find(m_pipelineRecipes, pipeline, &PipelineRecipe::pipeline);
+	if(recipe == m_pipelineRecipes.end()) {
+		return;
+	}
+	VkPipeline rebuilt = recipe->create();
+
+#ifdef SHADER_HOT_RELOAD
+	// a reload still waiting to be swapped in was built with the old specialization
+	discardReloadedPipeline(*pipeline);
+	std::scoped_lock lock(m_hotReloadMutex);
+	m_pipelineShaders.erase(*pipeline);
+#endif
+
+	vkDestroyPipeline(m_device, *pipeline, nullptr);
+	*pipeline = rebuilt;
 }
\ No newline at end of file
@@ -0,0 +1,268 @@
+#include "renderer.hpp"
+
+#ifdef SHADER_HOT_RELOAD
+
+#include <fstream>
+#include <format>
+#include <unordered_set>
+#include <chrono>
+#include <algorithm>
+
+static b8 isShaderFile(const std::filesystem::path& path) {
+	const std::filesystem::path ext = path.extension();
+	return ext == ".vert" || ext == ".frag" || ext == ".comp" || ext == ".glsl" || ext == ".h";
+}
+
+static b8 isShaderStage(const std::filesystem::path& path) {
+	const std::filesystem::path ext = path.extension();
+	return ext == ".vert" || ext == ".frag" || ext == ".comp";
+}
+
+// true if source is file or #includes it, directly or transitively
+static b8 dependsOn(const std::filesystem::path& source, const std::filesystem::path& file, std::unordered_set<std::filesystem::path>& visited) {
+	if(!visited.insert(source.lexically_normal()).second) {
+		return false;
+	}
+
+	if(source.lexically_normal() == file.lexically_normal()) {
+		return true;
+	}
+
+	std::ifstream stream(source);
+	std::string line;
+	while(std::getline(stream, line)) {
+		const u64 directive = line.find("#include \"");
+		if(directive == std::string::npos) {
+			continue;
+		}
+
+		const u64 begin = directive + 10;
+		const u64 end = line.find('"', begin);
+		if(end != std::string::npos && dependsOn(source.parent_path() / line.substr(begin, end - begin), file, visited)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+Renderer::ShaderSource Renderer::getShaderSource(std::filesystem::path path) {
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	std::vector<u32> ret(file.tellg() / sizeof(u32));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(ret.data()), ret.size() * sizeof(u32));
+	return ret;
+}
+
+// polls shaders/ and shared/, recompiles every stage affected by an edit with glslc and rebuilds the pipelines that use it
+void Renderer::watchShaders(std::stop_token stop) {
+	std::unordered_map<std::filesystem::path, std::filesystem::file_time_type> writeTimes;
+
+	auto scan = [&writeTimes]() {
+		std::vector<std::filesystem::path> changed;
+		for(const char* dir : { "shaders", "shared" }) {
+			for(const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(dir)) {
+				if(!isShaderFile(entry.path())) {
+					continue;
+				}
+
+				std::error_code error;
+				std::filesystem::file_time_type writeTime = entry.last_write_time(error);
+				auto [it, inserted] = writeTimes.try_emplace(entry.path(), writeTime);
+				if(!error && !inserted && it->second != writeTime) {
+					it->second = writeTime;
+					changed.push_back(entry.path());
+				}
+			}
+		}
+		return changed;
+	};
+
+	scan();
+
+	while(!stop.stop_requested()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+		std::vector<std::filesystem::path> changed = scan();
+		if(changed.empty()) {
+			continue;
+		}
+
+		std::vector<std::filesystem::path> recompiled;
+		for(const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator("shaders")) {
+			if(!isShaderStage(entry.path())) {
+				continue;
+			}
+
+			b8 affected = std::ranges::any_of(changed, [&entry](const std::filesystem::path& file) {
+				std::unordered_set<std::filesystem::path> visited;
+				return dependsOn(entry.path(), file, visited);
+			});
+
+			if(affected && std::system(std::format("glslc \"{0}\" -o \"{0}.spv\" --target-env=vulkan1.4", entry.path().string()).c_str()) == 0) {
+				recompiled.push_back(entry.path().string() + ".spv");
+			}
+		}
+
+		std::scoped_lock recipesLock(m_pipelineRecipesMutex);
+		for(const PipelineRecipe& recipe : m_pipelineRecipes) {
+			b8 affected;
+			{
+				std::scoped_lock lock(m_hotReloadMutex);
+				affected = std::ranges::any_of(m_pipelineShaders[*recipe.pipeline], [&recompiled](const std::filesystem::path& shader) {
+					return std::ranges::find(recompiled, shader) != recompiled.end();
+				});
+			}
+
+			if(affected) {
+				VkPipeline pipeline = recipe.create();
+				std::scoped_lock lock(m_hotReloadMutex);
+				m_reloadedPipelines.emplace_back(recipe.pipeline, pipeline);
+			}
+		}
+	}
+}
+
+// called between frames, retires the pipelines replaced by watchShaders
+void Renderer::swapReloadedPipelines() {
+	std::scoped_lock lock(m_hotReloadMutex);
+	if(m_reloadedPipelines.empty()) {
+		return;
+	}
+
+	vkDeviceWaitIdle(m_device);
+
+	for(auto [pipeline, reloaded] : m_reloadedPipelines) {
+		m_pipelineShaders.erase(*pipeline);
+		vkDestroyPipeline(m_device, *pipeline, nullptr);
+		*pipeline = reloaded;
+	}
+
+	m_reloadedPipelines.clear();
+}
+
+// drops a pending reload of a pipeline that's about to be destroyed or rebuilt, swapping it in later would write through a stale pointer
+void Renderer::discardReloadedPipeline(VkPipeline pipeline) {
+	std::scoped_lock lock(m_hotReloadMutex);
+	std::erase_if(m_reloadedPipelines, [this, pipeline](const std::pair<VkPipeline*, VkPipeline>& reloaded) {
+		if(*reloaded.first != pipeline) {
+			return false;
+		}
+		m_pipelineShaders.erase(reloaded.second);
+		vkDestroyPipeline(m_device, reloaded.second, nullptr);
+		return true;
+	});
+}
+
+#else
+
+// generated by shaders/compile.bat in the pre-build step, not checked in
+static constexpr u32 prepassVert[] =
+	#include "../shaders/prepass.vert.inc"
+;
+static constexpr u32 visibilityVert[] =
+	#include "../shaders/visibility.vert.inc"
+;
+static constexpr u32 shadowVert[] =
+	#include "../shaders/shadow.vert.inc"
+;
+static constexpr u32 modelVert[] =
+	#include "../shaders/model.vert.inc"
+;
+static constexpr u32 opaqueFrag[] =
+	#include "../shaders/opaque.frag.inc"
+;
+static constexpr u32 alphaTestFrag[] =
+	#include "../shaders/alphatest.frag.inc"
+;
+static constexpr u32 visibilityFrag[] =
+	#include "../shaders/visibility.frag.inc"
+;
+static constexpr u32 blendFrag[] =
+	#include "../shaders/blend.frag.inc"
+;
+static constexpr u32 wboitFrag[] =
+	#include "../shaders/wboit.frag.inc"
+;
+static constexpr u32 skyboxVert[] =
+	#include "../shaders/skybox.vert.inc"
+;
+static constexpr u32 skyboxFrag[] =
+	#include "../shaders/skybox.frag.inc"
+;
+static constexpr u32 mipComp[] =
+	#include "../shaders/mip.comp.inc"
+;
+static constexpr u32 srgbMipComp[] =
+	#include "../shaders/srgbmip.comp.inc"
+;
+static constexpr u32 cubeComp[] =
+	#include "../shaders/cube.comp.inc"
+;
+static constexpr u32 cubeMipComp[] =
+	#include "../shaders/cubemip.comp.inc"
+;
+static constexpr u32 irradianceComp[] =
+	#include "../shaders/irradiance.comp.inc"
+;
+static constexpr u32 radianceComp[] =
+	#include "../shaders/radiance.comp.inc"
+;
+static constexpr u32 brdfIntegralComp[] =
+	#include "../shaders/brdfintegral.comp.inc"
+;
+static constexpr u32 materialComp[] =
+	#include "../shaders/material.comp.inc"
+;
+static constexpr u32 oitResolveComp[] =
+	#include "../shaders/oitresolve.comp.inc"
+;
+static constexpr u32 postprocessComp[] =
+	#include "../shaders/postprocess.comp.inc"
+;
+static constexpr u32 bloomDownComp[] =
+	#include "../shaders/bloomdown.comp.inc"
+;
+static constexpr u32 bloomUpComp[] =
+	#include "../shaders/bloomup.comp.inc"
+;
+static constexpr u32 tonemapComp[] =
+	#include "../shaders/tonemap.comp.inc"
+;
+static constexpr u32 clusterComp[] =
+	#include "../shaders/cluster.comp.inc"
+;
+
+const std::unordered_map<std::string_view, Renderer::ShaderSource> Renderer::m_embeddedShaders = {
+	{ "shaders/prepass.vert.spv", prepassVert },
+	{ "shaders/visibility.vert.spv", visibilityVert },
+	{ "shaders/shadow.vert.spv", shadowVert },
+	{ "shaders/model.vert.spv", modelVert },
+	{ "shaders/opaque.frag.spv", opaqueFrag },
+	{ "shaders/alphatest.frag.spv", alphaTestFrag },
+	{ "shaders/visibility.frag.spv", visibilityFrag },
+	{ "shaders/blend.frag.spv", blendFrag },
+	{ "shaders/wboit.frag.spv", wboitFrag },
+	{ "shaders/skybox.vert.spv", skyboxVert },
+	{ "shaders/skybox.frag.spv", skyboxFrag },
+	{ "shaders/mip.comp.spv", mipComp },
+	{ "shaders/srgbmip.comp.spv", srgbMipComp },
+	{ "shaders/cube.comp.spv", cubeComp },
+	{ "shaders/cubemip.comp.spv", cubeMipComp },
+	{ "shaders/irradiance.comp.spv", irradianceComp },
+	{ "shaders/radiance.comp.spv", radianceComp },
+	{ "shaders/brdfintegral.comp.spv", brdfIntegralComp },
+	{ "shaders/material.comp.spv", materialComp },
+	{ "shaders/oitresolve.comp.spv", oitResolveComp },
+	{ "shaders/postprocess.comp.spv", postprocessComp },
+	{ "shaders/bloomdown.comp.spv", bloomDownComp },
+	{ "shaders/bloomup.comp.spv", bloomUpComp },
+	{ "shaders/tonemap.comp.spv", tonemapComp },
+	{ "shaders/cluster.comp.spv", clusterComp }
+};
+
+Renderer::ShaderSource Renderer::getShaderSource(std::filesystem::path path) {
+	return m_embeddedShaders.at(path.generic_string());
+}
+
+#endif
\ No newline at end of file
@@ -1,11 +1,53 @@
 #include "renderer.hpp"
 #include <ranges>
-#include <fstream>
+#include <algorithm>
 
 void Renderer::onResize() {
 	m_swapchainDirty = true;
 }
 
+void Renderer::onKey(i32 key, i32 action) {
+	if(action != GLFW_PRESS) return;
+
+	if(key == GLFW_KEY_P) {
+		auto it = std::ranges::find(m_presentModes, m_presentMode);
+		m_presentMode = (it == m_presentModes.end() || it + 1 == m_presentModes.end()) ? m_presentModes.front() : *(it + 1);
+	}
+	else if(key == GLFW_KEY_L) {
+		m_latencyLimiter = !m_latencyLimiter;
+	}
+	else if(key == GLFW_KEY_B && m_fragmentShaderInterlockSupported) {
+		m_weightedBlendedOIT = !m_weightedBlendedOIT;
+		m_oitDirty = true;
+		return;
+	}
+	else if(key == GLFW_KEY_O) {
+		m_oitNodeCount = m_oitNodeCount == 8 ? 2 : m_oitNodeCount * 2;
+		m_oitDirty = true;
+		return;
+	}
+	else if(key == GLFW_KEY_V && m_model.visibilityPipeline) {
+		m_visibilityBuffer = !m_visibilityBuffer;
+		return;
+	}
+	else if(key == GLFW_KEY_T) {
+		m_temporalAA = !m_temporalAA;
+		return;
+	}
+	else if(key == GLFW_KEY_U) {
+		m_renderScale = m_renderScale <= m_minRenderScale ? 1.0f : std::max(m_renderScale - 0.25f, m_minRenderScale);
+		m_dynamicResolution = false;
+		return;
+	}
+	else if(key == GLFW_KEY_R && m_gpuTimingSupported) {
+		m_dynamicResolution = !m_dynamicResolution;
+		return;
+	}
+	else return;
+
+	m_swapchainDirty = true;
+}
+
 u32 Renderer::getQueue(VkQueueFlags include, VkQueueFlags exclude) {
 	u32 size = 0;
 	vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &size, nullptr);
@@ -28,10 +70,42 @@ u32 Renderer::getMemoryIndex(VkMemoryPropertyFlags flags, u32 mask) {
 	}
 }
 
-std::vector<u32> Renderer::getShaderSource(std::filesystem::path path) {
-	std::ifstream file(path, std::ios::binary | std::ios::ate);
-	std::vector<u32> ret(file.tellg() / sizeof(u32));
-	file.seekg(0);
-	file.read(reinterpret_cast<char*>(ret.data()), ret.size() * sizeof(u32));
-	return ret;
+// how many bytes an upload may still take from the host visible device local heap, keeping a quarter of it free for the driver and the swapchain
+// without VK_EXT_memory_budget there's no telling what's already in use, so a single upload gets at most a quarter of the heap
+u64 Renderer::getDirectUploadBudget() {
+	if(m_directUploadMemoryType == ~0u) {
+		return 0;
+	}
+
+	const u32 heapIndex = m_memProps.memoryTypes[m_directUploadMemoryType].heapIndex;
+	if(!m_memoryBudgetSupported) {
+		return m_memProps.memoryHeaps[heapIndex].size / 4;
+	}
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {};
+	VkPhysicalDeviceMemoryProperties2 memProps = { .pNext = &budget };
+	vkGetPhysicalDeviceMemoryProperties2(m_physicalDevice, &memProps);
+	const u64 reserved = budget.heapBudget[heapIndex] / 4;
+	return budget.heapBudget[heapIndex] > budget.heapUsage[heapIndex] + reserved ? budget.heapBudget[heapIndex] - budget.heapUsage[heapIndex] - reserved : 0;
+}
+
+// pixel bounds of bounds under transform, clamped to the framebuffer
+VkRect2D Renderer::getScreenRect(const glm::mat4& transform, const AABB& bounds) {
+	glm::vec2 min(std::numeric_limits<f32>::infinity());
+	glm::vec2 max(-std::numeric_limits<f32>::infinity());
+
+	for(u32 i = 0; i < 8; i++) {
+		const glm::vec3 corner = { i & 1 ? bounds.max.x : bounds.min.x, i & 2 ? bounds.max.y : bounds.min.y, i & 4 ? bounds.max.z : bounds.min.z };
+		const glm::vec4 clip = transform * glm::vec4(corner, 1.0f);
+		if(clip.w <= 0.0f) {
+			return { { 0, 0 }, { static_cast<u32>(m_renderWidth), static_cast<u32>(m_renderHeight) } };
+		}
+		min = glm::min(min, glm::vec2(clip) / clip.w);
+		max = glm::max(max, glm::vec2(clip) / clip.w);
+	}
+
+	const glm::vec2 size(m_renderWidth, m_renderHeight);
+	const glm::ivec2 begin = glm::clamp(glm::ivec2(glm::floor((min * 0.5f + 0.5f) * size)), glm::ivec2(0), glm::ivec2(m_renderWidth, m_renderHeight));
+	const glm::ivec2 end = glm::clamp(glm::ivec2(glm::ceil((max * 0.5f + 0.5f) * size)), glm::ivec2(0), glm::ivec2(m_renderWidth, m_renderHeight));
+	return { { begin.x, begin.y }, { static_cast<u32>(end.x - begin.x), static_cast<u32>(end.y - begin.y) } };
 }
\ No newline at end of file
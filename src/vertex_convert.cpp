@@ -0,0 +1,133 @@
+#include "vertex_convert.hpp"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+
+// attributes come in as arrays of vec3/vec4, gathering a component across eight of them turns that into one register per component
+static const __m256i vec3Offsets = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+static const __m256i vec4Offsets = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+
+// row of a 3x3 transform (or the upper left of a 4x4), applied to eight vectors at once
+static inline __m256 transformRow(__m256 x, __m256 y, __m256 z, f32 m0, f32 m1, f32 m2) {
+	return _mm256_fmadd_ps(_mm256_set1_ps(m0), x, _mm256_fmadd_ps(_mm256_set1_ps(m1), y, _mm256_mul_ps(_mm256_set1_ps(m2), z)));
+}
+
+// normalizes eight vectors in place
+static inline void normalize(__m256& x, __m256& y, __m256& z) {
+	const __m256 invLength = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(_mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y, _mm256_mul_ps(z, z)))));
+	x = _mm256_mul_ps(x, invLength);
+	y = _mm256_mul_ps(y, invLength);
+	z = _mm256_mul_ps(z, invLength);
+}
+#endif
+
+void transformPositions(std::span<const glm::vec3> positions, const glm::mat4& transform, std::span<Vertex> vertices, glm::vec3& boundsMin, glm::vec3& boundsMax) {
+	u64 i = 0;
+#ifdef __AVX2__
+	__m256 minX = _mm256_set1_ps(boundsMin.x), minY = _mm256_set1_ps(boundsMin.y), minZ = _mm256_set1_ps(boundsMin.z);
+	__m256 maxX = _mm256_set1_ps(boundsMax.x), maxY = _mm256_set1_ps(boundsMax.y), maxZ = _mm256_set1_ps(boundsMax.z);
+	for(; i + 8 <= positions.size(); i += 8) {
+		const f32* src = &positions[i].x;
+		const __m256 x = _mm256_i32gather_ps(src, vec3Offsets, 4);
+		const __m256 y = _mm256_i32gather_ps(src + 1, vec3Offsets, 4);
+		const __m256 z = _mm256_i32gather_ps(src + 2, vec3Offsets, 4);
+
+		const __m256 outX = _mm256_add_ps(transformRow(x, y, z, transform[0][0], transform[1][0], transform[2][0]), _mm256_set1_ps(transform[3][0]));
+		const __m256 outY = _mm256_add_ps(transformRow(x, y, z, transform[0][1], transform[1][1], transform[2][1]), _mm256_set1_ps(transform[3][1]));
+		const __m256 outZ = _mm256_add_ps(transformRow(x, y, z, transform[0][2], transform[1][2], transform[2][2]), _mm256_set1_ps(transform[3][2]));
+
+		minX = _mm256_min_ps(minX, outX);
+		minY = _mm256_min_ps(minY, outY);
+		minZ = _mm256_min_ps(minZ, outZ);
+		maxX = _mm256_max_ps(maxX, outX);
+		maxY = _mm256_max_ps(maxY, outY);
+		maxZ = _mm256_max_ps(maxZ, outZ);
+
+		// there's no scatter, so the results are interleaved into the vertices on the way out
+		alignas(32) f32 out[3][8];
+		_mm256_store_ps(out[0], outX);
+		_mm256_store_ps(out[1], outY);
+		_mm256_store_ps(out[2], outZ);
+		for(u32 j = 0; j < 8; j++) {
+			vertices[i + j].position = glm::vec3(out[0][j], out[1][j], out[2][j]);
+		}
+	}
+
+	alignas(32) f32 lanes[6][8];
+	_mm256_store_ps(lanes[0], minX);
+	_mm256_store_ps(lanes[1], minY);
+	_mm256_store_ps(lanes[2], minZ);
+	_mm256_store_ps(lanes[3], maxX);
+	_mm256_store_ps(lanes[4], maxY);
+	_mm256_store_ps(lanes[5], maxZ);
+	for(u32 j = 0; j < 8; j++) {
+		boundsMin = glm::min(boundsMin, glm::vec3(lanes[0][j], lanes[1][j], lanes[2][j]));
+		boundsMax = glm::max(boundsMax, glm::vec3(lanes[3][j], lanes[4][j], lanes[5][j]));
+	}
+#endif
+
+	for(; i < positions.size(); i++) {
+		const glm::vec3 position = glm::vec3(transform * glm::vec4(positions[i], 1.0f));
+		boundsMin = glm::min(boundsMin, position);
+		boundsMax = glm::max(boundsMax, position);
+		vertices[i].position = position;
+	}
+}
+
+void transformNormals(std::span<const glm::vec3> normals, const glm::mat3& normalTransform, std::span<Vertex> vertices) {
+	u64 i = 0;
+#ifdef __AVX2__
+	for(; i + 8 <= normals.size(); i += 8) {
+		const f32* src = &normals[i].x;
+		const __m256 x = _mm256_i32gather_ps(src, vec3Offsets, 4);
+		const __m256 y = _mm256_i32gather_ps(src + 1, vec3Offsets, 4);
+		const __m256 z = _mm256_i32gather_ps(src + 2, vec3Offsets, 4);
+
+		__m256 outX = transformRow(x, y, z, normalTransform[0][0], normalTransform[1][0], normalTransform[2][0]);
+		__m256 outY = transformRow(x, y, z, normalTransform[0][1], normalTransform[1][1], normalTransform[2][1]);
+		__m256 outZ = transformRow(x, y, z, normalTransform[0][2], normalTransform[1][2], normalTransform[2][2]);
+		normalize(outX, outY, outZ);
+
+		alignas(32) f32 out[3][8];
+		_mm256_store_ps(out[0], outX);
+		_mm256_store_ps(out[1], outY);
+		_mm256_store_ps(out[2], outZ);
+		for(u32 j = 0; j < 8; j++) {
+			vertices[i + j].normal = glm::vec3(out[0][j], out[1][j], out[2][j]);
+		}
+	}
+#endif
+
+	for(; i < normals.size(); i++) {
+		vertices[i].normal = glm::normalize(normalTransform * normals[i]);
+	}
+}
+
+void transformTangents(std::span<const glm::vec4> tangents, const glm::mat3& normalTransform, std::span<Vertex> vertices) {
+	u64 i = 0;
+#ifdef __AVX2__
+	for(; i + 8 <= tangents.size(); i += 8) {
+		const f32* src = &tangents[i].x;
+		const __m256 x = _mm256_i32gather_ps(src, vec4Offsets, 4);
+		const __m256 y = _mm256_i32gather_ps(src + 1, vec4Offsets, 4);
+		const __m256 z = _mm256_i32gather_ps(src + 2, vec4Offsets, 4);
+
+		__m256 outX = transformRow(x, y, z, normalTransform[0][0], normalTransform[1][0], normalTransform[2][0]);
+		__m256 outY = transformRow(x, y, z, normalTransform[0][1], normalTransform[1][1], normalTransform[2][1]);
+		__m256 outZ = transformRow(x, y, z, normalTransform[0][2], normalTransform[1][2], normalTransform[2][2]);
+		normalize(outX, outY, outZ);
+
+		alignas(32) f32 out[3][8];
+		_mm256_store_ps(out[0], outX);
+		_mm256_store_ps(out[1], outY);
+		_mm256_store_ps(out[2], outZ);
+		for(u32 j = 0; j < 8; j++) {
+			vertices[i + j].tangent = glm::vec4(out[0][j], out[1][j], out[2][j], tangents[i + j].w);
+		}
+	}
+#endif
+
+	for(; i < tangents.size(); i++) {
+		vertices[i].tangent = glm::vec4(glm::normalize(normalTransform * glm::vec3(tangents[i])), tangents[i].w);
+	}
+}
\ No newline at end of file
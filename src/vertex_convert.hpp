@@ -0,0 +1,21 @@
+#ifndef VERTEX_CONVERT_HPP
+#define VERTEX_CONVERT_HPP
+
+#include <tbrs/types.hpp>
+#include <glm/glm.hpp>
+#include <span>
+#include "../shared/vertex.h"
+
+// bulk kernels for turning a primitive's attributes, copied out of their accessors in one go, into interleaved vertices
+// eight vertices at a time with AVX2 (which the project is built with), with a scalar loop for the remainder and for other targets
+
+// writes transform * position to every vertex's position, growing the bounds to contain them
+void transformPositions(std::span<const glm::vec3> positions, const glm::mat4& transform, std::span<Vertex> vertices, glm::vec3& boundsMin, glm::vec3& boundsMax);
+
+// writes the normalized normalTransform * normal to every vertex's normal
+void transformNormals(std::span<const glm::vec3> normals, const glm::mat3& normalTransform, std::span<Vertex> vertices);
+
+// the same for the tangent's direction, keeping w as its handedness
+void transformTangents(std::span<const glm::vec4> tangents, const glm::mat3& normalTransform, std::span<Vertex> vertices);
+
+#endif
\ No newline at end of file